@@ -0,0 +1,364 @@
+#include <posix/net/event_loop.h>
+#include <posix/net/server.h>
+#include <util/opt/options.h>
+
+#include <sys/poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <csignal>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+// Closed-loop echo benchmark: the load generator keeps exactly one request in
+// flight per connection. The server runs in a child process so that its
+// syscalls can be taken from /proc/<pid>/io, which counts the read and write
+// families only: poller waits and send/recv (used by the coroutine server)
+// are not included
+namespace {
+    using TClock = std::chrono::steady_clock;
+
+    struct TScenario {
+        ESocket Transport;
+        std::size_t Connections;
+        std::size_t Payload;
+    };
+
+    struct TResult {
+        std::size_t Requests = 0;
+        std::vector<std::uint32_t> Latencies;
+    };
+
+    EPollBackend ParseBackend(std::string_view backend) {
+        if (backend == "poll") {
+            return EPollBackend::Poll;
+        }
+        if (backend == "epoll") {
+            return EPollBackend::Epoll;
+        }
+        if (backend == "io_uring") {
+            return EPollBackend::IoUring;
+        }
+        throw TException{"Unknown backend ", backend};
+    }
+
+    std::vector<std::size_t> ParseList(std::string_view list) {
+        std::vector<std::size_t> result;
+        while (!list.empty()) {
+            auto pos = std::min(list.find(','), list.size());
+            result.push_back(std::stoul(std::string{list.substr(0, pos)}));
+            list.remove_prefix(std::min(pos + 1, list.size()));
+        }
+        return result;
+    }
+
+    std::vector<ESocket> ParseTransports(std::string_view transport) {
+        if (transport == "ip") {
+            return {ESocket::IP};
+        }
+        if (transport == "unix") {
+            return {ESocket::UNIX};
+        }
+        if (transport == "all") {
+            return {ESocket::IP, ESocket::UNIX};
+        }
+        throw TException{"Unknown transport ", transport};
+    }
+
+    bool ReactorEcho(TConnectedSocket& socket) {
+        // the first byte fills the stream buffer, the rest of what was read
+        // is echoed without further syscalls
+        std::array<char, 1 << 16> buffer;
+        if (!socket.read(buffer.data(), 1)) {
+            // a spurious wakeup, the server waits for the next one
+            return socket.WouldBlock();
+        }
+        auto size = 1 + socket.readsome(buffer.data() + 1, buffer.size() - 1);
+        socket.write(buffer.data(), size);
+        socket.flush();
+        return socket.good();
+    }
+
+    TTask<void> CoroutineEcho(TEventLoop& loop, TConnectedSocket socket) {
+        std::array<std::byte, 1 << 16> buffer;
+        while (auto size = co_await loop.ReadSome(socket, buffer)) {
+            co_await loop.WriteAll(socket, std::span{buffer}.first(size));
+        }
+    }
+
+    TTask<void> CoroutineAcceptor(TEventLoop& loop, const TSocket& listener) {
+        while (true) {
+            loop.Spawn(CoroutineEcho(loop, co_await loop.Accept(listener)));
+        }
+    }
+
+    void Ready(int notify, int port) {
+        if (write(notify, std::addressof(port), sizeof(port)) != sizeof(port)) {
+            std::_Exit(1);
+        }
+        close(notify);
+    }
+
+    TSocket Listen(ESocket transport, const std::filesystem::path& path) {
+        TSocket socket{transport};
+        if (transport == ESocket::IP) {
+            NInternal::InitIPSocket(socket, 0, 4096);
+        } else {
+            NInternal::InitUNIXSocket(socket, path, 4096);
+        }
+        return socket;
+    }
+
+    [[noreturn]]
+    void RunServer(
+        ESocket transport, const std::filesystem::path& path, std::string_view mode,
+        EPollBackend backend, std::size_t reactors, int notify)
+    {
+        if (mode == "coroutine") {
+            auto listener = Listen(transport, path);
+            NInternal::SetNonBlocking(listener);
+            TEventLoop loop{4096, backend};
+            loop.Spawn(CoroutineAcceptor(loop, listener));
+            Ready(notify, transport == ESocket::IP ? NInternal::GetPort(listener) : 0);
+            loop.Run();
+            std::_Exit(0);
+        }
+
+        TServerConfig config;
+        config.Reactors = std::max<std::size_t>(reactors, 1);
+        config.PoolCapacity = 4096;
+        config.Backend = backend;
+        config.ReusePort = true;
+        if (transport == ESocket::IP) {
+            TServer server{ReactorEcho, 0, 4096, config};
+            Ready(notify, NInternal::GetPort(server.GetSocket()));
+            server();
+        } else {
+            TServer server{ReactorEcho, path, 4096, config};
+            Ready(notify, 0);
+            server();
+        }
+        std::_Exit(0);
+    }
+
+    int Dial(ESocket transport, const std::filesystem::path& path, int port) {
+        int fd = socket(transport == ESocket::IP ? AF_INET : AF_LOCAL, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd < 0) {
+            throw std::system_error{std::error_code{errno, std::system_category()}};
+        }
+        int res;
+        if (transport == ESocket::IP) {
+            sockaddr_in address{};
+            address.sin_family = AF_INET;
+            address.sin_port = htons(port);
+            address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+            int enable = 1;
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, std::addressof(enable), sizeof(enable));
+            res = connect(fd, reinterpret_cast<sockaddr*>(std::addressof(address)), sizeof(address));
+        } else {
+            sockaddr_un address{};
+            address.sun_family = AF_LOCAL;
+            std::strncpy(address.sun_path, path.c_str(), sizeof(address.sun_path) - 1);
+            res = connect(fd, reinterpret_cast<sockaddr*>(std::addressof(address)), sizeof(address));
+        }
+        if (res < 0) {
+            close(fd);
+            throw std::system_error{std::error_code{errno, std::system_category()}};
+        }
+        return fd;
+    }
+
+    void Generate(const std::vector<int>& fds, std::size_t payload, TClock::time_point deadline, TResult& result) {
+        struct TConnection {
+            TClock::time_point Sent;
+            std::size_t Received = 0;
+        };
+
+        std::vector<char> request(payload, 'x');
+        std::vector<char> response(payload);
+        std::vector<pollfd> polled;
+        std::vector<TConnection> connections(fds.size());
+        for (auto fd : fds) {
+            polled.push_back(pollfd{fd, POLLIN, 0});
+        }
+
+        auto send = [&](std::size_t i) {
+            connections[i] = TConnection{TClock::now(), 0};
+            for (std::size_t sent = 0; sent < payload;) {
+                auto res = ::send(fds[i], request.data() + sent, payload - sent, MSG_NOSIGNAL);
+                if (res <= 0) {
+                    throw std::system_error{std::error_code{errno, std::system_category()}};
+                }
+                sent += static_cast<std::size_t>(res);
+            }
+        };
+
+        for (std::size_t i = 0; i < fds.size(); ++i) {
+            send(i);
+        }
+        while (TClock::now() < deadline) {
+            if (poll(polled.data(), polled.size(), 100) <= 0) {
+                continue;
+            }
+            for (std::size_t i = 0; i < polled.size(); ++i) {
+                if (polled[i].revents == 0) {
+                    continue;
+                }
+                auto& connection = connections[i];
+                auto res = recv(fds[i], response.data(), payload - connection.Received, MSG_DONTWAIT);
+                if (res <= 0) {
+                    if (res < 0 && (errno == EAGAIN || errno == EINTR)) {
+                        continue;
+                    }
+                    throw TException{"Connection closed by server"};
+                }
+                connection.Received += static_cast<std::size_t>(res);
+                if (connection.Received == payload) {
+                    auto latency = std::chrono::duration_cast<std::chrono::microseconds>(TClock::now() - connection.Sent);
+                    result.Latencies.push_back(static_cast<std::uint32_t>(latency.count()));
+                    ++result.Requests;
+                    send(i);
+                }
+            }
+        }
+    }
+
+    std::size_t ServerSyscalls(pid_t pid) {
+        std::ifstream io{"/proc/" + std::to_string(pid) + "/io"};
+        std::string key;
+        std::size_t value;
+        std::size_t total = 0;
+        while (io >> key >> value) {
+            if (key == "syscr:" || key == "syscw:") {
+                total += value;
+            }
+        }
+        return total;
+    }
+
+    double Percentile(const std::vector<std::uint32_t>& sorted, double percentile) {
+        if (sorted.empty()) {
+            return 0;
+        }
+        auto index = static_cast<std::size_t>(percentile * static_cast<double>(sorted.size() - 1));
+        return sorted[index];
+    }
+
+    void Run(
+        const TScenario& scenario, std::string_view mode, EPollBackend backend,
+        std::size_t reactors, std::size_t threads, std::chrono::milliseconds duration)
+    {
+        auto path = std::filesystem::temp_directory_path() / ("echo_bench." + std::to_string(getpid()));
+        std::filesystem::remove(path);
+        std::array<int, 2> notify{};
+        if (pipe(notify.data()) < 0) {
+            throw std::system_error{std::error_code{errno, std::system_category()}};
+        }
+        auto pid = fork();
+        if (pid < 0) {
+            throw std::system_error{std::error_code{errno, std::system_category()}};
+        }
+        if (pid == 0) {
+            // a client may hang up while its last response is being written
+            std::signal(SIGPIPE, SIG_IGN);
+            close(notify[0]);
+            RunServer(scenario.Transport, path, mode, backend, reactors, notify[1]);
+        }
+        close(notify[1]);
+        int port = 0;
+        auto res = read(notify[0], std::addressof(port), sizeof(port));
+        close(notify[0]);
+        if (res != sizeof(port)) {
+            throw TException{"Server failed to start"};
+        }
+
+        std::vector<std::vector<int>> fds(std::min(threads, scenario.Connections));
+        for (std::size_t i = 0; i < scenario.Connections; ++i) {
+            fds[i % fds.size()].push_back(Dial(scenario.Transport, path, port));
+        }
+        std::vector<TResult> results(fds.size());
+        auto before = ServerSyscalls(pid);
+        auto start = TClock::now();
+        {
+            std::vector<std::jthread> generators;
+            for (std::size_t i = 0; i < fds.size(); ++i) {
+                generators.emplace_back(Generate, std::cref(fds[i]), scenario.Payload, start + duration, std::ref(results[i]));
+            }
+        }
+        for (auto&& group : fds) {
+            for (auto fd : group) {
+                close(fd);
+            }
+        }
+        auto elapsed = std::chrono::duration<double>(TClock::now() - start).count();
+        auto syscalls = ServerSyscalls(pid) - before;
+        kill(pid, SIGKILL);
+        waitpid(pid, nullptr, 0);
+        std::filesystem::remove(path);
+
+        TResult total;
+        for (auto&& result : results) {
+            total.Requests += result.Requests;
+            total.Latencies.insert(total.Latencies.end(), result.Latencies.begin(), result.Latencies.end());
+        }
+        std::sort(total.Latencies.begin(), total.Latencies.end());
+        auto requests = std::max<std::size_t>(total.Requests, 1);
+
+        std::cout << std::left << std::setw(6) << (scenario.Transport == ESocket::IP ? "ip" : "unix")
+                  << std::right << std::setw(7) << scenario.Connections
+                  << std::setw(9) << scenario.Payload
+                  << std::fixed << std::setprecision(0)
+                  << std::setw(12) << static_cast<double>(total.Requests) / elapsed
+                  << std::setw(10) << Percentile(total.Latencies, 0.5)
+                  << std::setw(10) << Percentile(total.Latencies, 0.99)
+                  << std::setw(10) << Percentile(total.Latencies, 0.999)
+                  << std::setprecision(2)
+                  << std::setw(10) << static_cast<double>(syscalls) / static_cast<double>(requests)
+                  << std::endl;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    TOptions options{
+        argc, argv, TParamList<>{},
+        TOpt<std::string_view>{"mode", "server flavour: reactor or coroutine", "reactor"},
+        TOpt<std::string_view>{"backend", "poller backend: poll, epoll or io_uring", "epoll"},
+        TOpt<std::string_view>{"transport", "ip, unix or all", "all"},
+        TOpt<std::string_view>{"connections", "comma-separated connection counts", "1,16,256"},
+        TOpt<std::string_view>{"payloads", "comma-separated payload sizes in bytes", "16,1024,16384"},
+        TOpt<long long>{"reactors", "reactor threads of the server", 1},
+        TOpt<long long>{"threads", "load generator threads", 4},
+        TOpt<long long>{"duration", "milliseconds per scenario", 1000}
+    };
+
+    auto mode = options.Get<std::string_view>("mode");
+    auto backend = ParseBackend(options.Get<std::string_view>("backend"));
+    auto reactors = static_cast<std::size_t>(options.Get<long long>("reactors"));
+    auto threads = static_cast<std::size_t>(std::max<long long>(options.Get<long long>("threads"), 1));
+    std::chrono::milliseconds duration{options.Get<long long>("duration")};
+
+    std::cout << "mode=" << mode << " backend=" << options.Get<std::string_view>("backend")
+              << " reactors=" << reactors << " threads=" << threads << "\n"
+              << std::left << std::setw(6) << "net" << std::right << std::setw(7) << "conns"
+              << std::setw(9) << "payload" << std::setw(12) << "req/s" << std::setw(10) << "p50us"
+              << std::setw(10) << "p99us" << std::setw(10) << "p999us" << std::setw(10) << "rw/req" << std::endl;
+    for (auto transport : ParseTransports(options.Get<std::string_view>("transport"))) {
+        for (auto connections : ParseList(options.Get<std::string_view>("connections"))) {
+            for (auto payload : ParseList(options.Get<std::string_view>("payloads"))) {
+                Run(TScenario{transport, connections, payload}, mode, backend, reactors, threads, duration);
+            }
+        }
+    }
+}
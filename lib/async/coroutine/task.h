@@ -0,0 +1,161 @@
+#pragma once
+
+#include <coroutine>
+#include <exception>
+#include <optional>
+#include <utility>
+
+template <typename T = void>
+class TTask;
+
+namespace NInternal {
+    template <typename T>
+    class TTaskPromiseBase {
+        struct TFinalAwaiter {
+            bool await_ready() const noexcept {
+                return false;
+            }
+
+            template <typename TPromise>
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<TPromise> handle) noexcept {
+                return handle.promise().Continuation;
+            }
+
+            void await_resume() const noexcept {}
+        };
+
+    public:
+        std::suspend_always initial_suspend() const noexcept {
+            return {};
+        }
+
+        TFinalAwaiter final_suspend() const noexcept {
+            return {};
+        }
+
+        void unhandled_exception() noexcept {
+            Error = std::current_exception();
+        }
+
+        void Rethrow() const {
+            if (Error) {
+                std::rethrow_exception(Error);
+            }
+        }
+
+    public:
+        std::coroutine_handle<> Continuation = std::noop_coroutine();
+
+    private:
+        std::exception_ptr Error;
+    };
+
+    template <typename T>
+    class TTaskPromise : public TTaskPromiseBase<T> {
+    public:
+        TTask<T> get_return_object() noexcept;
+
+        template <typename TValue>
+        void return_value(TValue&& value) {
+            Value.emplace(std::forward<TValue>(value));
+        }
+
+        T Result() {
+            this->Rethrow();
+            return std::move(*Value);
+        }
+
+    private:
+        std::optional<T> Value;
+    };
+
+    template <>
+    class TTaskPromise<void> : public TTaskPromiseBase<void> {
+    public:
+        TTask<void> get_return_object() noexcept;
+
+        void return_void() const noexcept {}
+
+        void Result() const {
+            Rethrow();
+        }
+    };
+}
+
+// Lazily started coroutine: the body runs once the task is awaited, and the
+// awaiting coroutine is resumed by symmetric transfer when it finishes
+template <typename T>
+class TTask {
+public:
+    using promise_type = NInternal::TTaskPromise<T>;
+    using THandle = std::coroutine_handle<promise_type>;
+
+public:
+    explicit TTask(THandle handle) noexcept
+        : Handle{handle}
+    {}
+
+    TTask(const TTask&) = delete;
+    TTask& operator=(const TTask&) = delete;
+
+    TTask(TTask&& other) noexcept
+        : Handle{std::exchange(other.Handle, nullptr)}
+    {}
+
+    TTask& operator=(TTask&& other) noexcept {
+        if (this != std::addressof(other)) {
+            Destroy();
+            Handle = std::exchange(other.Handle, nullptr);
+        }
+        return *this;
+    }
+
+    ~TTask() {
+        Destroy();
+    }
+
+    auto operator co_await() noexcept {
+        struct TAwaiter {
+            bool await_ready() const noexcept {
+                return Handle.done();
+            }
+
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<> continuation) noexcept {
+                Handle.promise().Continuation = continuation;
+                return Handle;
+            }
+
+            T await_resume() {
+                return Handle.promise().Result();
+            }
+
+            THandle Handle;
+        };
+        return TAwaiter{Handle};
+    }
+
+    [[nodiscard]]
+    bool Done() const noexcept {
+        return !Handle || Handle.done();
+    }
+
+private:
+    void Destroy() noexcept {
+        if (Handle) {
+            Handle.destroy();
+            Handle = nullptr;
+        }
+    }
+
+private:
+    THandle Handle;
+};
+
+template <typename T>
+TTask<T> NInternal::TTaskPromise<T>::get_return_object() noexcept {
+    return TTask<T>{TTask<T>::THandle::from_promise(*this)};
+}
+
+inline TTask<void> NInternal::TTaskPromise<void>::get_return_object() noexcept {
+    return TTask<void>{TTask<void>::THandle::from_promise(*this)};
+}
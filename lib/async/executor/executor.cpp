@@ -0,0 +1,193 @@
+#include "executor.h"
+
+#include <util/exception/exception.h>
+
+#include <algorithm>
+#include <utility>
+
+namespace {
+    thread_local const TExecutor* CurrentExecutor = nullptr;
+    thread_local std::size_t CurrentWorker = 0;
+}
+
+TExecutor::TExecutor(TStopToken& token, std::size_t workers, std::chrono::milliseconds tick)
+    : Token{token}
+    , Tick{tick}
+    , Queues{}
+    , Pending{0}
+    , Active{0}
+    , Next{0}
+    , SleepMutex{}
+    , Wakeup{}
+    , Sleepers{0}
+    , ErrorMutex{}
+    , Error{}
+    , Threads{}
+{
+    workers = std::max<std::size_t>(workers, 1);
+    Queues.reserve(workers);
+    for (std::size_t i = 0; i < workers; ++i) {
+        Queues.push_back(std::make_unique<TWorker>());
+    }
+    Threads.reserve(workers);
+    Active.store(workers, std::memory_order_relaxed);
+    try {
+        for (std::size_t i = 0; i < workers; ++i) {
+            Threads.emplace_back(&TExecutor::Run, this, i);
+        }
+    } catch (...) {
+        Shutdown();
+        throw;
+    }
+}
+
+TExecutor::~TExecutor() {
+    try {
+        Shutdown();
+    } catch (...) {
+        // destructor must be noexcept
+    }
+}
+
+void TExecutor::Submit(TTask task) {
+    auto index = CurrentExecutor == this
+        ? CurrentWorker
+        : Next.fetch_add(1, std::memory_order_relaxed) % Queues.size();
+    // counted before it's visible, so workers never exit with a task in flight
+    Pending.fetch_add(1, std::memory_order_seq_cst);
+    // a worker leaving now sees the task counted, see Leave
+    if (Active.load(std::memory_order_seq_cst) == 0) {
+        Pending.fetch_sub(1, std::memory_order_relaxed);
+        throw TException{"Task submitted after the executor has stopped"};
+    }
+    try {
+        auto& worker = *Queues[index];
+        std::lock_guard lock{worker.Mutex};
+        worker.Tasks.push_back(std::move(task));
+    } catch (...) {
+        Pending.fetch_sub(1, std::memory_order_relaxed);
+        throw;
+    }
+    if (Sleepers.load(std::memory_order_seq_cst) > 0) {
+        std::lock_guard lock{SleepMutex};
+        Wakeup.notify_one();
+    }
+}
+
+void TExecutor::Join() {
+    for (auto&& thread : Threads) {
+        if (thread.joinable()) {
+            thread.join();
+        }
+    }
+    std::lock_guard lock{ErrorMutex};
+    if (Error) {
+        std::rethrow_exception(std::exchange(Error, nullptr));
+    }
+}
+
+void TExecutor::Shutdown() {
+    Token.Stop();
+    {
+        std::lock_guard lock{SleepMutex};
+        Wakeup.notify_all();
+    }
+    Join();
+}
+
+std::size_t TExecutor::Workers() const noexcept {
+    return Queues.size();
+}
+
+void TExecutor::Run(std::size_t index) {
+    CurrentExecutor = this;
+    CurrentWorker = index;
+    while (true) {
+        if (auto task = Pop(index)) {
+            Execute(*task);
+        } else if (auto stolen = Steal(index)) {
+            Execute(*stolen);
+        } else if (Token && Pending.load(std::memory_order_seq_cst) == 0 && Leave()) {
+            break;
+        } else {
+            Sleep();
+        }
+    }
+    CurrentExecutor = nullptr;
+}
+
+bool TExecutor::Leave() noexcept {
+    Active.fetch_sub(1, std::memory_order_seq_cst);
+    if (Pending.load(std::memory_order_seq_cst) == 0) {
+        return true;
+    }
+    // a task came in meanwhile, and Submit saw this worker still active
+    Active.fetch_add(1, std::memory_order_seq_cst);
+    return false;
+}
+
+std::optional<TExecutor::TTask> TExecutor::Pop(std::size_t index) {
+    auto& worker = *Queues[index];
+    std::lock_guard lock{worker.Mutex};
+    if (worker.Tasks.empty()) {
+        return std::nullopt;
+    }
+    auto task = std::move(worker.Tasks.back());
+    worker.Tasks.pop_back();
+    Pending.fetch_sub(1, std::memory_order_relaxed);
+    return task;
+}
+
+std::optional<TExecutor::TTask> TExecutor::Steal(std::size_t index) {
+    TWorker* busy = nullptr;
+    for (std::size_t i = 1; i < Queues.size(); ++i) {
+        auto& victim = *Queues[(index + i) % Queues.size()];
+        // a busy victim is skipped for a free one first
+        std::unique_lock lock{victim.Mutex, std::try_to_lock};
+        if (!lock) {
+            busy = busy == nullptr ? std::addressof(victim) : busy;
+            continue;
+        }
+        if (auto task = TakeFront(victim)) {
+            return task;
+        }
+    }
+    // otherwise the task behind the busy lock is waited for, Sleep would
+    // return at once while it's pending and this worker would spin
+    if (busy != nullptr) {
+        std::lock_guard lock{busy->Mutex};
+        return TakeFront(*busy);
+    }
+    return std::nullopt;
+}
+
+std::optional<TExecutor::TTask> TExecutor::TakeFront(TWorker& victim) {
+    if (victim.Tasks.empty()) {
+        return std::nullopt;
+    }
+    auto task = std::move(victim.Tasks.front());
+    victim.Tasks.pop_front();
+    Pending.fetch_sub(1, std::memory_order_relaxed);
+    return task;
+}
+
+void TExecutor::Execute(TTask& task) {
+    try {
+        task();
+    } catch (...) {
+        std::lock_guard lock{ErrorMutex};
+        if (!Error) {
+            Error = std::current_exception();
+        }
+    }
+}
+
+void TExecutor::Sleep() {
+    std::unique_lock lock{SleepMutex};
+    Sleepers.fetch_add(1, std::memory_order_seq_cst);
+    // the token is polled every tick, since stopping it doesn't notify us
+    Wakeup.wait_for(lock, Tick, [this] {
+        return Pending.load(std::memory_order_seq_cst) > 0 || static_cast<bool>(Token);
+    });
+    Sleepers.fetch_sub(1, std::memory_order_relaxed);
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <async/stop_token/stop_token.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <vector>
+
+// Thread pool where every worker owns a deque: tasks submitted by a worker go
+// to its own deque, tasks from other threads are spread round-robin, and idle
+// workers steal from the front of the others' deques.
+// Workers exit once the token is stopped and all queued tasks have run
+class TExecutor {
+public:
+    using TTask = std::function<void()>;
+
+public:
+    explicit TExecutor(
+        TStopToken& token,
+        std::size_t workers = std::thread::hardware_concurrency(),
+        std::chrono::milliseconds tick = std::chrono::milliseconds{100});
+
+    TExecutor(const TExecutor&) = delete;
+    TExecutor& operator=(const TExecutor&) = delete;
+
+    ~TExecutor();
+
+    // throws once the workers have exited, the task would never run
+    void Submit(TTask task);
+
+    // waits for the workers to drain their queues after the token is stopped
+    // and rethrows the first exception thrown by a task
+    void Join();
+
+    void Shutdown();
+
+    [[nodiscard]]
+    std::size_t Workers() const noexcept;
+
+private:
+    struct alignas(64) TWorker {
+        std::mutex Mutex;
+        std::deque<TTask> Tasks;
+    };
+
+private:
+    void Run(std::size_t index);
+
+    std::optional<TTask> Pop(std::size_t index);
+
+    std::optional<TTask> Steal(std::size_t index);
+
+    // the victim is locked by the caller
+    std::optional<TTask> TakeFront(TWorker& victim);
+
+    // stops counting the worker as active unless a task was submitted
+    bool Leave() noexcept;
+
+    void Execute(TTask& task);
+
+    void Sleep();
+
+private:
+    TStopToken& Token;
+    std::chrono::milliseconds Tick;
+    std::vector<std::unique_ptr<TWorker>> Queues;
+    std::atomic<std::size_t> Pending;
+    // workers that haven't exited, Submit refuses tasks once there are none
+    std::atomic<std::size_t> Active;
+    std::atomic<std::size_t> Next;
+
+    std::mutex SleepMutex;
+    std::condition_variable Wakeup;
+    std::atomic<std::size_t> Sleepers;
+
+    std::mutex ErrorMutex;
+    std::exception_ptr Error;
+    std::vector<std::thread> Threads;
+};
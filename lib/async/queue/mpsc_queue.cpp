@@ -0,0 +1 @@
+#include "mpsc_queue.h"
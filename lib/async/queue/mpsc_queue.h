@@ -0,0 +1,71 @@
+#pragma once
+
+#include <atomic>
+#include <optional>
+#include <utility>
+
+// Unbounded multi-producer single-consumer queue: Push may be called from any
+// thread, Pop only from the consumer. A push that is still in progress may be
+// invisible to Pop until it completes
+template <typename T>
+class TMpscQueue {
+public:
+    TMpscQueue()
+        : Stub{}
+        , Head{std::addressof(Stub)}
+        , Tail{std::addressof(Stub)}
+    {}
+
+    TMpscQueue(const TMpscQueue&) = delete;
+    TMpscQueue& operator=(const TMpscQueue&) = delete;
+
+    ~TMpscQueue() {
+        while (Pop()) {
+        }
+        if (Tail != std::addressof(Stub)) {
+            delete Tail;
+        }
+    }
+
+    void Push(T value) {
+        auto node = new TNode{std::move(value)};
+        auto prev = Head.exchange(node, std::memory_order_acq_rel);
+        prev->Next.store(node, std::memory_order_release);
+    }
+
+    std::optional<T> Pop() {
+        auto next = Tail->Next.load(std::memory_order_acquire);
+        if (next == nullptr) {
+            return std::nullopt;
+        }
+        std::optional<T> value{std::move(next->Value)};
+        next->Value.reset();
+        if (Tail != std::addressof(Stub)) {
+            delete Tail;
+        }
+        Tail = next;
+        return value;
+    }
+
+    [[nodiscard]]
+    bool Empty() const noexcept {
+        return Tail->Next.load(std::memory_order_acquire) == nullptr;
+    }
+
+private:
+    struct TNode {
+        TNode() = default;
+
+        explicit TNode(T&& value)
+            : Value{std::move(value)}
+        {}
+
+        std::atomic<TNode*> Next{nullptr};
+        std::optional<T> Value;
+    };
+
+private:
+    TNode Stub;
+    std::atomic<TNode*> Head;
+    TNode* Tail;
+};
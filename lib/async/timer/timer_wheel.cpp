@@ -0,0 +1,218 @@
+#include "timer_wheel.h"
+
+#include <algorithm>
+#include <bit>
+
+TTimerWheel::TTimerWheel(std::chrono::milliseconds tick, TClock::time_point start)
+    : Start{start}
+    , Tick{std::max<TClock::duration>(tick, TClock::duration{1})}
+    , Current{0}
+    , Count{0}
+    , Nodes{}
+    , FreeList{Nil}
+    , Heads{}
+    , Occupied{}
+{
+    Heads.fill(Nil);
+}
+
+TTimerWheel::TTimerId TTimerWheel::Arm(TClock::time_point deadline, std::uint64_t cookie) {
+    auto index = Allocate();
+    auto& node = Nodes[index];
+    node.Deadline = std::max(CeilTick(deadline), Current);
+    node.Cookie = cookie;
+    Insert(index);
+    ++Count;
+    return {index, node.Generation};
+}
+
+TTimerWheel::TTimerId TTimerWheel::Arm(TClock::duration delay, std::uint64_t cookie) {
+    return Arm(TClock::now() + delay, cookie);
+}
+
+bool TTimerWheel::Cancel(TTimerId id) {
+    if (id.Index >= Nodes.size()) {
+        return false;
+    }
+    auto& node = Nodes[id.Index];
+    if (node.Generation != id.Generation || node.Slot == Nil) {
+        return false;
+    }
+    Unlink(id.Index);
+    Free(id.Index);
+    --Count;
+    return true;
+}
+
+std::size_t TTimerWheel::Advance(TClock::time_point now, std::span<std::uint64_t> expired) {
+    // a tick is over only once now has passed its end
+    auto target = std::max(FloorTick(now), Current);
+    if (Count == 0) {
+        Current = target;
+        return 0;
+    }
+    std::size_t count = 0;
+    while (true) {
+        auto slot = static_cast<std::uint32_t>(Current & (Slots - 1));
+        while (Heads[slot] != Nil) {
+            if (count == expired.size()) {
+                return count;
+            }
+            auto index = Heads[slot];
+            expired[count++] = Nodes[index].Cookie;
+            Unlink(index);
+            Free(index);
+            --Count;
+        }
+        if (Current == target) {
+            return count;
+        }
+
+        // skip straight to the next occupied slot or to the next block boundary
+        auto next = (Current | (Slots - 1)) + 1;
+        if (slot + 1 < Slots) {
+            if (auto bits = Occupied[0] >> (slot + 1); bits != 0) {
+                next = Current + 1 + std::countr_zero(bits);
+            }
+        }
+        Current = std::min(next, target);
+        if ((Current & (Slots - 1)) == 0) {
+            Cascade();
+        }
+    }
+}
+
+std::optional<TTimerWheel::TClock::duration> TTimerWheel::NextTimeout(TClock::time_point now) const {
+    if (Count == 0) {
+        return std::nullopt;
+    }
+
+    std::uint64_t tick = Current;
+    for (std::size_t level = 0; level < Levels; ++level) {
+        auto shift = level * SlotBits;
+        auto pos = (Current >> shift) & (Slots - 1);
+        auto bits = Occupied[level];
+        if (bits == 0) {
+            continue;
+        }
+        // the current slot of an upper level has already been cascaded
+        auto from = level == 0 ? pos : pos + 1;
+        auto parent = (Current >> (shift + SlotBits)) << (shift + SlotBits);
+        if (from < Slots && (bits >> from) != 0) {
+            tick = parent + ((from + static_cast<std::uint64_t>(std::countr_zero(bits >> from))) << shift);
+        } else {
+            tick = parent + (std::uint64_t{1} << (shift + SlotBits)) + (static_cast<std::uint64_t>(std::countr_zero(bits)) << shift);
+        }
+        break;
+    }
+
+    auto deadline = Start + Tick * static_cast<TClock::rep>(tick);
+    return deadline > now ? deadline - now : TClock::duration::zero();
+}
+
+std::size_t TTimerWheel::Size() const noexcept {
+    return Count;
+}
+
+bool TTimerWheel::Empty() const noexcept {
+    return Count == 0;
+}
+
+std::uint64_t TTimerWheel::CeilTick(TClock::time_point time) const {
+    if (time <= Start) {
+        return 0;
+    }
+    auto elapsed = time - Start;
+    auto ticks = static_cast<std::uint64_t>(elapsed / Tick);
+    return elapsed % Tick == TClock::duration::zero() ? ticks : ticks + 1;
+}
+
+std::uint64_t TTimerWheel::FloorTick(TClock::time_point time) const {
+    if (time <= Start) {
+        return 0;
+    }
+    return static_cast<std::uint64_t>((time - Start) / Tick);
+}
+
+std::uint32_t TTimerWheel::Allocate() {
+    if (FreeList != Nil) {
+        auto index = FreeList;
+        FreeList = Nodes[index].Next;
+        return index;
+    }
+    Nodes.push_back(TNode{0, 0, Nil, Nil, 0, Nil});
+    return static_cast<std::uint32_t>(Nodes.size() - 1);
+}
+
+void TTimerWheel::Free(std::uint32_t index) {
+    auto& node = Nodes[index];
+    ++node.Generation;
+    node.Slot = Nil;
+    node.Prev = Nil;
+    node.Next = FreeList;
+    FreeList = index;
+}
+
+void TTimerWheel::Insert(std::uint32_t index) {
+    auto deadline = Nodes[index].Deadline;
+    constexpr auto range = Levels * SlotBits;
+    if ((deadline >> range) != (Current >> range)) {
+        // past the top level's rotation, the first top level slot is reached
+        // next when the rotation ends and the timer is inserted again then
+        Link(index, static_cast<std::uint32_t>((Levels - 1) * Slots));
+        return;
+    }
+    // the lowest level whose parent block contains both now and the deadline
+    std::size_t level = 0;
+    while (level + 1 < Levels && (deadline >> ((level + 1) * SlotBits)) != (Current >> ((level + 1) * SlotBits))) {
+        ++level;
+    }
+    auto slot = (deadline >> (level * SlotBits)) & (Slots - 1);
+    Link(index, static_cast<std::uint32_t>(level * Slots + slot));
+}
+
+void TTimerWheel::Link(std::uint32_t index, std::uint32_t slot) {
+    auto& node = Nodes[index];
+    node.Slot = slot;
+    node.Prev = Nil;
+    node.Next = Heads[slot];
+    if (node.Next != Nil) {
+        Nodes[node.Next].Prev = index;
+    }
+    Heads[slot] = index;
+    Occupied[slot / Slots] |= std::uint64_t{1} << (slot % Slots);
+}
+
+void TTimerWheel::Unlink(std::uint32_t index) {
+    auto& node = Nodes[index];
+    if (node.Prev != Nil) {
+        Nodes[node.Prev].Next = node.Next;
+    } else {
+        Heads[node.Slot] = node.Next;
+    }
+    if (node.Next != Nil) {
+        Nodes[node.Next].Prev = node.Prev;
+    }
+    if (Heads[node.Slot] == Nil) {
+        Occupied[node.Slot / Slots] &= ~(std::uint64_t{1} << (node.Slot % Slots));
+    }
+    node.Slot = Nil;
+}
+
+void TTimerWheel::Cascade() {
+    std::size_t top = 1;
+    while (top + 1 < Levels && ((Current >> (top * SlotBits)) & (Slots - 1)) == 0) {
+        ++top;
+    }
+    for (auto level = top; level > 0; --level) {
+        auto slot = static_cast<std::uint32_t>(level * Slots + ((Current >> (level * SlotBits)) & (Slots - 1)));
+        auto index = Heads[slot];
+        Heads[slot] = Nil;
+        Occupied[level] &= ~(std::uint64_t{1} << (slot % Slots));
+        while (index != Nil) {
+            auto next = Nodes[index].Next;
+            Insert(index);
+            index = next;
+        }
+    }
+}
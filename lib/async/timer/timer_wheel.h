@@ -0,0 +1,92 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <vector>
+
+// Hierarchical timing wheel: every level has 64 slots and covers 64 times
+// the range of the level below. Arming and cancelling are O(1), timers move
+// to a lower level once their slot at the current level is reached.
+class TTimerWheel {
+    static constexpr std::size_t SlotBits = 6;
+    static constexpr std::size_t Slots = 1 << SlotBits;
+    static constexpr std::size_t Levels = 6;
+    static constexpr std::uint32_t Nil = ~std::uint32_t{0};
+
+public:
+    using TClock = std::chrono::steady_clock;
+
+    struct TTimerId {
+        std::uint32_t Index = Nil;
+        std::uint32_t Generation = 0;
+
+        bool operator==(const TTimerId& other) const = default;
+    };
+
+public:
+    explicit TTimerWheel(
+        std::chrono::milliseconds tick = std::chrono::milliseconds{1},
+        TClock::time_point start = TClock::now());
+
+    TTimerId Arm(TClock::time_point deadline, std::uint64_t cookie);
+
+    TTimerId Arm(TClock::duration delay, std::uint64_t cookie);
+
+    // returns false if the timer has already expired or been cancelled
+    bool Cancel(TTimerId id);
+
+    // writes cookies of expired timers, timers that don't fit are reported by the next call
+    std::size_t Advance(TClock::time_point now, std::span<std::uint64_t> expired);
+
+    [[nodiscard]]
+    std::optional<TClock::duration> NextTimeout(TClock::time_point now) const;
+
+    [[nodiscard]]
+    std::size_t Size() const noexcept;
+
+    [[nodiscard]]
+    bool Empty() const noexcept;
+
+private:
+    struct TNode {
+        std::uint64_t Deadline;
+        std::uint64_t Cookie;
+        std::uint32_t Prev;
+        std::uint32_t Next;
+        std::uint32_t Generation;
+        std::uint32_t Slot;
+    };
+
+private:
+    // deadlines are rounded up to a tick and the current time down, so no
+    // timer fires before its deadline
+    std::uint64_t CeilTick(TClock::time_point time) const;
+
+    std::uint64_t FloorTick(TClock::time_point time) const;
+
+    std::uint32_t Allocate();
+
+    void Free(std::uint32_t index);
+
+    void Insert(std::uint32_t index);
+
+    void Link(std::uint32_t index, std::uint32_t slot);
+
+    void Unlink(std::uint32_t index);
+
+    void Cascade();
+
+private:
+    TClock::time_point Start;
+    TClock::duration Tick;
+    std::uint64_t Current;
+    std::size_t Count;
+
+    std::vector<TNode> Nodes;
+    std::uint32_t FreeList;
+    std::array<std::uint32_t, Levels * Slots> Heads;
+    std::array<std::uint64_t, Levels> Occupied;
+};
@@ -125,6 +125,18 @@ std::ostream& operator<<(std::ostream& stream, const THttpResponseMessage& messa
     return stream;
 }
 
+void AppendTo(TBufferList& buffers, const THttpResponseMessage& message) {
+    buffers.Own(message.GetVersion() + ' ' + std::to_string(message.GetStatus()) + ' ' + message.GetDescription() + "\r\n");
+    for (auto&& [key, value] : message.GetAllHeaders()) {
+        buffers.Borrow(key);
+        buffers.Borrow(": ");
+        buffers.Borrow(value);
+        buffers.Borrow("\r\n");
+    }
+    buffers.Borrow("\r\n");
+    buffers.Borrow(message.GetBody());
+}
+
 std::string_view Prepare(std::string& curLine) {
     if (curLine.back() == '\r') {
         curLine.pop_back();
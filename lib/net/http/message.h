@@ -1,5 +1,7 @@
 #pragma once
 
+#include <util/memory/buffer_list.h>
+
 #include <istream>
 #include <ostream>
 
@@ -94,3 +96,7 @@ private:
 std::istream& operator>>(std::istream& stream, THttpResponseMessage& message);
 
 std::ostream& operator<<(std::ostream& stream, const THttpResponseMessage& message);
+
+// Serializes without copying the headers or the body, the message must
+// outlive the write of the buffers
+void AppendTo(TBufferList& buffers, const THttpResponseMessage& message);
@@ -1 +1,83 @@
 #include "fd_stream.h"
+
+#include <sys/uio.h>
+
+#include <array>
+#include <cerrno>
+
+namespace {
+    // bigger buffers aren't worth copying to save an iovec
+    constexpr std::size_t CoalesceLimit = 512;
+
+    constexpr std::size_t GatherBatch = 64;
+}
+
+std::size_t NInternal::Coalesce(std::span<std::byte> room, TBufferList& buffers) noexcept {
+    std::size_t copied = 0;
+    for (auto&& segment : buffers.Segments()) {
+        auto size = segment.Data.size();
+        if (size > CoalesceLimit || size > room.size() - copied) {
+            break;
+        }
+        std::memcpy(room.data() + copied, segment.Data.data(), size);
+        copied += size;
+    }
+    buffers.Consume(copied);
+    return copied;
+}
+
+std::size_t NInternal::GatherWrite(
+    const IFd& fd, TIoRecorder& recorder, std::span<const std::byte> buffered, TBufferList& buffers)
+{
+    std::array<iovec, GatherBatch> vectors{};
+    std::size_t total = 0;
+    while (!buffered.empty() || !buffers.Empty()) {
+        std::size_t count = 0;
+        std::size_t requested = 0;
+        if (!buffered.empty()) {
+            vectors[count++] = iovec{const_cast<std::byte*>(buffered.data()), buffered.size()};
+            requested += buffered.size();
+        }
+        for (auto&& segment : buffers.Segments()) {
+            if (count == vectors.size()) {
+                break;
+            }
+            vectors[count++] = iovec{const_cast<std::byte*>(segment.Data.data()), segment.Data.size()};
+            requested += segment.Data.size();
+        }
+
+        auto written = recorder.Write(requested, [&] {
+            return writev(fd.Get(), vectors.data(), static_cast<int>(count));
+        });
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+        auto size = static_cast<std::size_t>(written);
+        total += size;
+        auto fromBuffered = std::min(size, buffered.size());
+        buffered = buffered.subspan(fromBuffered);
+        buffers.Consume(size - fromBuffered);
+        if (size == 0) {
+            break;
+        }
+    }
+    return total;
+}
+
+std::size_t NInternal::WriteAll(const IFd& fd, TIoRecorder& recorder, std::span<const std::byte> data) {
+    std::size_t written = 0;
+    while (written < data.size()) {
+        auto wr = static_cast<std::ptrdiff_t>(recorder.Write(data.size() - written, [&] {
+            return Write(fd, data.data() + written, data.size() - written);
+        }));
+        if (wr > 0) {
+            written += static_cast<std::size_t>(wr);
+        } else if (wr == 0 || errno != EINTR) {
+            break;
+        }
+    }
+    return written;
+}
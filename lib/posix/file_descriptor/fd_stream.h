@@ -1,66 +1,189 @@
 #pragma once
 
+#include <posix/file_descriptor/io_counters.h>
 #include <posix/file_descriptor/shared_fd.h>
 #include <posix/file_descriptor/syscalls.h>
 
+#include <util/memory/buffer_list.h>
+#include <util/memory/buffer_pool.h>
+
 #include <istream>
 #include <ostream>
 #include <streambuf>
 
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
 #include <memory>
+#include <span>
+#include <utility>
+
+namespace NInternal {
+    // A stream buffer taken from the shared pool only while there's data in
+    // it, so an idle stream keeps just the size of its next buffer
+    class TPooledBuffer {
+    public:
+        explicit TPooledBuffer(std::size_t size) noexcept
+            : Data{}
+            , Size{std::max<std::size_t>(size, 2)}
+        {
+        }
+
+        TPooledBuffer(TPooledBuffer&& buffer) noexcept
+            : Data{std::exchange(buffer.Data, {})}
+            , Size{buffer.Size}
+        {
+        }
+
+        TPooledBuffer& operator=(TPooledBuffer&& buffer) noexcept {
+            if (this != std::addressof(buffer)) {
+                Release();
+                Data = std::exchange(buffer.Data, {});
+                Size = buffer.Size;
+            }
+            return *this;
+        }
+
+        ~TPooledBuffer() {
+            Release();
+        }
+
+        // the buffer held or a new one of at least Size chars
+        template <typename TChar>
+        std::span<TChar> Acquire() {
+            if (Data.empty()) {
+                Data = TBufferPool::Default().Acquire(Size * sizeof(TChar));
+            }
+            return {reinterpret_cast<TChar*>(Data.data()), Data.size() / sizeof(TChar)};
+        }
+
+        // a buffer twice as big that starts with the used chars of the held one
+        template <typename TChar>
+        std::span<TChar> Grow(std::size_t used) {
+            auto data = TBufferPool::Default().Acquire(2 * Data.size());
+            std::memcpy(data.data(), Data.data(), used * sizeof(TChar));
+            Release();
+            Data = data;
+            return {reinterpret_cast<TChar*>(Data.data()), Data.size() / sizeof(TChar)};
+        }
+
+        void Release() noexcept {
+            if (!Data.empty()) {
+                TBufferPool::Default().Release(std::exchange(Data, {}));
+            }
+        }
+
+        void SetSize(std::size_t size) noexcept {
+            Size = std::max<std::size_t>(size, 2);
+        }
+
+    private:
+        std::span<std::byte> Data;
+        std::size_t Size;
+    };
+
+    // Writes until all of the data is written or a write fails, returns the
+    // number of bytes written
+    std::size_t WriteAll(const IFd& fd, TIoRecorder& recorder, std::span<const std::byte> data);
+
+    // Copies the small buffers at the front of the list into the room left
+    // in a put area, so they go out with the buffered output. Returns the
+    // number of bytes copied, they are consumed from the list
+    std::size_t Coalesce(std::span<std::byte> room, TBufferList& buffers) noexcept;
+
+    // Writes the buffered output and then the list with writev until all of
+    // it is written or a write fails. Returns the number of bytes written,
+    // the written part of the list is consumed
+    std::size_t GatherWrite(
+        const IFd& fd, TIoRecorder& recorder, std::span<const std::byte> buffered, TBufferList& buffers);
+
+    // Writes the put area and the list, then moves what's left of the put area
+    // to its start. Returns the number of put area bytes left
+    template <typename TChar>
+    std::size_t WriteBuffers(const IFd& fd, TIoRecorder& recorder, TChar* start, TChar*& end, TChar* limit, TBufferList& buffers) {
+        if constexpr (sizeof(TChar) == 1) {
+            auto room = std::span{reinterpret_cast<std::byte*>(end), static_cast<std::size_t>(limit - end)};
+            end += Coalesce(room, buffers);
+        }
+        auto buffered = static_cast<std::size_t>(end - start) * sizeof(TChar);
+        auto written = GatherWrite(fd, recorder, {reinterpret_cast<const std::byte*>(start), buffered}, buffers);
+        auto left = buffered - std::min(written, buffered);
+        std::memmove(start, reinterpret_cast<std::byte*>(start) + buffered - left, left);
+        end = start + left / sizeof(TChar);
+        return left;
+    }
+}
 
 template <typename TChar, typename TCloser>
 class TBasicIFdStreamBuf : public std::basic_streambuf<TChar> {
 public:
+    using TTraits = typename std::basic_streambuf<TChar>::traits_type;
+
+public:
+    // the get area stays empty until there's something to read
     TBasicIFdStreamBuf(TBasicSharedFd<TCloser> fd, std::size_t buffSize)
-        : Buffer(std::make_unique<TChar[]>(buffSize))
-        , Size{buffSize}
+        : Buffer{buffSize}
         , Fd{std::move(fd)}
+        , Recorder{}
     {
-        auto start = Buffer.get();
-        auto end = start + Size;
-        this->setg(start, end, end);
     }
 
     TBasicIFdStreamBuf(TBasicIFdStreamBuf&& streamBuf) noexcept
         : Buffer{std::move(streamBuf.Buffer)}
-        , Size{streamBuf.Size}
         , Fd{std::move(streamBuf.Fd)}
+        , Recorder{streamBuf.Recorder}
     {
-        this->setg(Buffer.get(), streamBuf.gptr(), Buffer.get() + Size);
+        Restore(streamBuf);
     }
 
     TBasicIFdStreamBuf& operator=(TBasicIFdStreamBuf&& streamBuf) noexcept {
         Buffer = std::move(streamBuf.Buffer);
-        Size = streamBuf.Size;
         Fd = std::move(streamBuf.Fd);
-        auto start = Buffer.get();
-        auto end = start + Size;
-        this->setg(start, start + std::distance(streamBuf.eback(), streamBuf.gptr()), end);
+        Recorder = streamBuf.Recorder;
+        Restore(streamBuf);
         return *this;
     }
 
     int underflow() override {
         if (this->gptr() < this->egptr()) {
-            return *this->gptr();
+            return TTraits::to_int_type(*this->gptr());
         }
 
         if (sync() == 0) {
-            return *this->gptr();
+            return TTraits::to_int_type(*this->gptr());
         }
-        return std::basic_streambuf<TChar>::traits_type::eof();
+        return TTraits::eof();
     }
 
     int sync() override {
-        auto start = this->eback();
-        auto rd = NInternal::Read(Fd, reinterpret_cast<std::byte*>(start), Size * sizeof(TChar));
-        this->setg(start, start, start + rd);
+        auto buffer = Buffer.template Acquire<TChar>();
+        auto rd = static_cast<std::ptrdiff_t>(Recorder.Read(buffer.size_bytes(), [&] {
+            return NInternal::Read(Fd, reinterpret_cast<std::byte*>(buffer.data()), buffer.size_bytes());
+        }));
         if (rd > 0) {
+            this->setg(buffer.data(), buffer.data(), buffer.data() + rd / sizeof(TChar));
             return 0;
         }
+        // nothing to keep on EOF, an error or an empty non-blocking fd
+        this->setg(nullptr, nullptr, nullptr);
+        Buffer.Release();
         return -1;
     }
 
+    // Returns the buffer to the pool if all of the buffered input has been
+    // read, e.g. before the fd goes idle
+    void Trim() noexcept {
+        if (this->gptr() == this->egptr()) {
+            this->setg(nullptr, nullptr, nullptr);
+            Buffer.Release();
+        }
+    }
+
+    // applies to the buffers taken from now on
+    void SetBufferSize(std::size_t buffSize) noexcept {
+        Buffer.SetSize(buffSize);
+    }
+
     void Open(TBasicSharedFd<TCloser> fd) {
         Fd = std::move(fd);
     }
@@ -79,71 +202,114 @@ public:
         return Fd;
     }
 
+    [[nodiscard]]
+    TIoCounters GetCounters() const noexcept {
+        return Recorder.Get();
+    }
+
+    // for I/O on the fd that bypasses the buffer
+    NInternal::TIoRecorder& GetRecorder() noexcept {
+        return Recorder;
+    }
+
+private:
+    // the pooled buffer doesn't move, so the area is taken over as it is
+    void Restore(TBasicIFdStreamBuf& streamBuf) noexcept {
+        this->setg(streamBuf.eback(), streamBuf.gptr(), streamBuf.egptr());
+        streamBuf.setg(nullptr, nullptr, nullptr);
+    }
+
 private:
-    std::unique_ptr<TChar[]> Buffer;
-    std::size_t Size;
+    NInternal::TPooledBuffer Buffer;
     TBasicSharedFd<TCloser> Fd;
+    [[no_unique_address]] NInternal::TIoRecorder Recorder;
 };
 
 template <typename TChar, typename TCloser>
 class TBasicOFdStreamBuf : public std::basic_streambuf<TChar> {
 public:
+    using TTraits = typename std::basic_streambuf<TChar>::traits_type;
+
+public:
+    // the put area stays empty until something is written
     TBasicOFdStreamBuf(TBasicSharedFd<TCloser> fd, std::size_t buffSize)
-        : Buffer(std::make_unique<TChar[]>(buffSize))
-        , Size(buffSize)
+        : Buffer{buffSize}
         , Fd{std::move(fd)}
+        , Recorder{}
     {
-        auto start = Buffer.get();
-        auto end = start + Size - 1;
-        this->setp(start, end);
     }
 
     TBasicOFdStreamBuf(TBasicOFdStreamBuf&& streamBuf) noexcept
         : Buffer{std::move(streamBuf.Buffer)}
-        , Size{streamBuf.Size}
         , Fd{std::move(streamBuf.Fd)}
+        , Recorder{streamBuf.Recorder}
     {
-        auto start = Buffer.get();
-        auto end = start + Size - 1;
-        this->setp(start, end);
-        this->pbump(streamBuf.pptr() - streamBuf.pbase());
+        Restore(streamBuf);
     }
 
     TBasicOFdStreamBuf& operator=(TBasicOFdStreamBuf&& streamBuf) noexcept {
         Buffer = std::move(streamBuf.Buffer);
-        Size = streamBuf.Size;
         Fd = std::move(streamBuf.Fd);
-        auto start = Buffer.get();
-        auto end = start + Size - 1;
-        this->setp(start, end);
-        this->pbump(streamBuf.pptr() - streamBuf.pbase());
+        Recorder = streamBuf.Recorder;
+        Restore(streamBuf);
         return *this;
     }
 
+    // the char is put only once the full buffer is written, so a failed
+    // write never leaves it buffered while eof is returned
     int overflow(int c) override {
-        if (c != std::basic_streambuf<TChar>::traits_type::eof()) {
-            *this->pptr() = c;
-            this->pbump(1);
-
-            if (sync() == 0) {
-                return c;
-            }
+        if (c == TTraits::eof()) {
+            return TTraits::eof();
         }
-
-        return std::basic_streambuf<TChar>::traits_type::eof();
+        if (this->pbase() != nullptr && sync() != 0) {
+            return TTraits::eof();
+        }
+        auto buffer = Buffer.template Acquire<TChar>();
+        this->setp(buffer.data(), buffer.data() + buffer.size());
+        *this->pptr() = TTraits::to_char_type(c);
+        this->pbump(1);
+        return c;
     }
 
+    // the buffer goes back to the pool once all of it is written
     int sync() override {
-        auto sz = this->pptr() - this->pbase();
-        if (sz > 0) {
-            auto wr = NInternal::Write(Fd, reinterpret_cast<std::byte*>(this->pbase()), sz * sizeof(TChar));
-            if (wr > 0) {
-                this->pbump(-wr);
-                return 0;
-            }
-            return -1;
+        if (this->pbase() == nullptr) {
+            return 0;
+        }
+        auto size = static_cast<std::size_t>(this->pptr() - this->pbase()) * sizeof(TChar);
+        auto written = NInternal::WriteAll(Fd, Recorder, {reinterpret_cast<const std::byte*>(this->pbase()), size});
+        Consume(written);
+        return written == size ? 0 : -1;
+    }
+
+    // Writes the buffered output followed by the buffers with as few writev
+    // calls as possible. Small buffers are copied behind the buffered output,
+    // the others go to the kernel from where they are. The list keeps what a
+    // failed write left, false is returned then
+    bool WriteBuffers(TBufferList& buffers) {
+        if (this->pbase() == nullptr) {
+            NInternal::GatherWrite(Fd, Recorder, {}, buffers);
+            return buffers.Empty();
+        }
+        auto end = this->pptr();
+        auto left = NInternal::WriteBuffers(Fd, Recorder, this->pbase(), end, this->epptr(), buffers);
+        this->setp(this->pbase(), this->epptr());
+        this->pbump(static_cast<int>(end - this->pbase()));
+        Trim();
+        return left == 0 && buffers.Empty();
+    }
+
+    // returns the buffer to the pool if nothing is left to write
+    void Trim() noexcept {
+        if (this->pptr() == this->pbase()) {
+            this->setp(nullptr, nullptr);
+            Buffer.Release();
         }
-        return 0;
+    }
+
+    // applies to the buffers taken from now on
+    void SetBufferSize(std::size_t buffSize) noexcept {
+        Buffer.SetSize(buffSize);
     }
 
     void Open(TBasicSharedFd<TCloser> fd) {
@@ -164,89 +330,189 @@ public:
         return Fd;
     }
 
+    [[nodiscard]]
+    TIoCounters GetCounters() const noexcept {
+        return Recorder.Get();
+    }
+
+    // for I/O on the fd that bypasses the buffer
+    NInternal::TIoRecorder& GetRecorder() noexcept {
+        return Recorder;
+    }
+
 private:
-    std::unique_ptr<TChar[]> Buffer;
-    std::size_t Size;
+    // drops the written bytes from the put area
+    void Consume(std::size_t sz) noexcept {
+        auto written = static_cast<std::ptrdiff_t>(sz / sizeof(TChar));
+        auto left = this->pptr() - this->pbase() - written;
+        std::memmove(this->pbase(), this->pbase() + written, left * sizeof(TChar));
+        this->setp(this->pbase(), this->epptr());
+        this->pbump(static_cast<int>(left));
+        Trim();
+    }
+
+    void Restore(TBasicOFdStreamBuf& streamBuf) noexcept {
+        this->setp(streamBuf.pbase(), streamBuf.epptr());
+        this->pbump(static_cast<int>(streamBuf.pptr() - streamBuf.pbase()));
+        streamBuf.setp(nullptr, nullptr);
+    }
+
+private:
+    NInternal::TPooledBuffer Buffer;
     TBasicSharedFd<TCloser> Fd;
+    [[no_unique_address]] NInternal::TIoRecorder Recorder;
 };
 
 template <typename TChar, typename TCloser>
 class TBasicFdStreamBuf : public std::basic_streambuf<TChar> {
 public:
+    using TTraits = typename std::basic_streambuf<TChar>::traits_type;
+
+public:
+    // get and put areas have separate buffers, so buffered input survives
+    // writing a response. Both are taken only while they're needed
     explicit TBasicFdStreamBuf(TBasicSharedFd<TCloser> fd, std::size_t buffSize)
-        : Buffer(std::make_unique<TChar[]>(buffSize))
-        , Size(buffSize)
+        : Input{buffSize}
+        , Output{buffSize}
         , Fd{std::move(fd)}
+        , Recorder{}
+        , Blocked{false}
     {
-        auto start = Buffer.get();
-        auto end = start + Size;
-        this->setg(start, end, end);
-        this->setp(start, end - 1);
     }
 
     TBasicFdStreamBuf(TBasicFdStreamBuf&& streamBuf) noexcept
-        : Buffer{std::move(streamBuf.Buffer)}
-        , Size{streamBuf.Size}
+        : Input{std::move(streamBuf.Input)}
+        , Output{std::move(streamBuf.Output)}
         , Fd{std::move(streamBuf.Fd)}
+        , Recorder{streamBuf.Recorder}
+        , Blocked{streamBuf.Blocked}
     {
-        auto start = Buffer.get();
-        auto end = start + Size;
-        this->setg(start, start + std::distance(streamBuf.eback(), streamBuf.gptr()), end);
-        this->setp(start, end - 1);
-        this->pbump(streamBuf.pptr() - streamBuf.pbase());
+        Restore(streamBuf);
     }
 
     TBasicFdStreamBuf& operator=(TBasicFdStreamBuf&& streamBuf) noexcept {
-        Buffer = std::move(streamBuf.Buffer);
-        Size = streamBuf.Size;
+        Input = std::move(streamBuf.Input);
+        Output = std::move(streamBuf.Output);
         Fd = std::move(streamBuf.Fd);
-        auto start = Buffer.get();
-        auto end = start + Size;
-        this->setg(start, start + std::distance(streamBuf.eback(), streamBuf.gptr()), end);
-        this->setp(start, end - 1);
-        this->pbump(streamBuf.pptr() - streamBuf.pbase());
+        Recorder = streamBuf.Recorder;
+        Blocked = streamBuf.Blocked;
+        Restore(streamBuf);
         return *this;
     }
 
     int underflow() override {
         if (this->gptr() < this->egptr()) {
-            return *this->gptr();
+            return TTraits::to_int_type(*this->gptr());
         }
 
-        auto start = this->eback();
-        auto rd = NInternal::Read(Fd, reinterpret_cast<std::byte*>(start), Size * sizeof(TChar));
-        this->setg(start, start, start + rd);
-
+        auto buffer = Input.template Acquire<TChar>();
+        auto rd = static_cast<std::ptrdiff_t>(Recorder.Read(buffer.size_bytes(), [&] {
+            return NInternal::Read(Fd, reinterpret_cast<std::byte*>(buffer.data()), buffer.size_bytes());
+        }));
+        Blocked = rd < 0 && IsBlocked();
         if (rd > 0) {
-            return *this->gptr();
+            this->setg(buffer.data(), buffer.data(), buffer.data() + rd / sizeof(TChar));
+            return TTraits::to_int_type(*this->gptr());
         }
-        return std::basic_streambuf<TChar>::traits_type::eof();
+        this->setg(nullptr, nullptr, nullptr);
+        Input.Release();
+        return TTraits::eof();
     }
 
+    // the char is put only once the buffered output is written or would
+    // block, so a failed write never leaves it buffered while eof is returned
     int overflow(int c) override {
-        if (c != std::basic_streambuf<TChar>::traits_type::eof()) {
-            *this->pptr() = c;
-            this->pbump(1);
+        if (c == TTraits::eof()) {
+            return TTraits::eof();
+        }
+        if (this->pbase() != nullptr && sync() != 0) {
+            return TTraits::eof();
+        }
+        if (this->pbase() == nullptr) {
+            auto buffer = Output.template Acquire<TChar>();
+            this->setp(buffer.data(), buffer.data() + buffer.size());
+        } else if (this->pptr() == this->epptr()) {
+            // nothing could be written to a non-blocking fd, the output is
+            // kept in a bigger buffer instead of failing
+            auto used = this->pptr() - this->pbase();
+            auto buffer = Output.template Grow<TChar>(static_cast<std::size_t>(used));
+            this->setp(buffer.data(), buffer.data() + buffer.size());
+            this->pbump(static_cast<int>(used));
+        }
+        *this->pptr() = TTraits::to_char_type(c);
+        this->pbump(1);
+        return c;
+    }
 
-            if (sync() == 0) {
-                return c;
-            }
+    // Output that would block on a non-blocking fd stays buffered and isn't
+    // an error, it's written by the next sync once the fd is writable
+    int sync() override {
+        if (this->pbase() == nullptr) {
+            return 0;
+        }
+        auto size = static_cast<std::size_t>(this->pptr() - this->pbase()) * sizeof(TChar);
+        auto written = NInternal::WriteAll(Fd, Recorder, {reinterpret_cast<const std::byte*>(this->pbase()), size});
+        Blocked = written < size && IsBlocked();
+        Consume(written);
+        return written == size || Blocked ? 0 : -1;
+    }
+
+    // Writes the buffered output followed by the buffers with as few writev
+    // calls as possible. Small buffers are copied behind the buffered output,
+    // the others go to the kernel from where they are. What would block on a
+    // non-blocking fd is buffered like in overflow and the list is emptied.
+    // The list keeps what a failed write left, false is returned then
+    bool WriteBuffers(TBufferList& buffers) {
+        if (this->pbase() == nullptr) {
+            NInternal::GatherWrite(Fd, Recorder, {}, buffers);
+            Blocked = !buffers.Empty() && IsBlocked();
+        } else {
+            auto end = this->pptr();
+            auto left = NInternal::WriteBuffers(Fd, Recorder, this->pbase(), end, this->epptr(), buffers);
+            this->setp(this->pbase(), this->epptr());
+            this->pbump(static_cast<int>(end - this->pbase()));
+            Blocked = (left != 0 || !buffers.Empty()) && IsBlocked();
         }
+        if (Blocked && !buffers.Empty()) {
+            Keep(buffers);
+        }
+        TrimOutput();
+        return buffers.Empty() && (Unflushed() == 0 || Blocked);
+    }
 
-        return std::basic_streambuf<TChar>::traits_type::eof();
+    // whether the last read or write stopped because a non-blocking fd
+    // wasn't ready
+    [[nodiscard]]
+    bool WouldBlock() const noexcept {
+        return Blocked;
     }
 
-    int sync() override {
-        auto sz = this->pptr() - this->pbase();
-        if (sz > 0) {
-            auto wr = NInternal::Write(Fd, reinterpret_cast<std::byte*>(this->pbase()), sz * sizeof(TChar));
-            if (wr > 0) {
-                this->pbump(-wr);
-                return 0;
-            }
-            return -1;
+    // chars buffered for output
+    [[nodiscard]]
+    std::size_t Unflushed() const noexcept {
+        return static_cast<std::size_t>(this->pptr() - this->pbase());
+    }
+
+    // drops the buffered output unwritten, e.g. a request cut short
+    void DiscardOutput() noexcept {
+        this->setp(this->pbase(), this->epptr());
+        TrimOutput();
+    }
+
+    // Returns the buffers to the pool if all of the buffered input has been
+    // read and all of the output written, e.g. before a connection goes idle
+    void Trim() noexcept {
+        if (this->gptr() == this->egptr()) {
+            this->setg(nullptr, nullptr, nullptr);
+            Input.Release();
         }
-        return 0;
+        TrimOutput();
+    }
+
+    // applies to the buffers taken from now on
+    void SetBufferSize(std::size_t buffSize) noexcept {
+        Input.SetSize(buffSize);
+        Output.SetSize(buffSize);
     }
 
     void Open(TBasicSharedFd<TCloser> fd) {
@@ -267,18 +533,83 @@ public:
         return Fd;
     }
 
+    [[nodiscard]]
+    TIoCounters GetCounters() const noexcept {
+        return Recorder.Get();
+    }
+
+    // for I/O on the fd that bypasses the buffer
+    NInternal::TIoRecorder& GetRecorder() noexcept {
+        return Recorder;
+    }
+
+private:
+    // drops the written bytes from the put area
+    void Consume(std::size_t sz) noexcept {
+        auto written = static_cast<std::ptrdiff_t>(sz / sizeof(TChar));
+        auto left = this->pptr() - this->pbase() - written;
+        std::memmove(this->pbase(), this->pbase() + written, left * sizeof(TChar));
+        this->setp(this->pbase(), this->epptr());
+        this->pbump(static_cast<int>(left));
+        TrimOutput();
+    }
+
+    static bool IsBlocked() noexcept {
+        return errno == EAGAIN || errno == EWOULDBLOCK;
+    }
+
+    // copies the list behind the put area, growing it, so it's written by
+    // the next sync. The list holds whole chars
+    void Keep(TBufferList& buffers) {
+        auto chars = buffers.Size() / sizeof(TChar);
+        if (this->pbase() == nullptr) {
+            auto buffer = Output.template Acquire<TChar>();
+            this->setp(buffer.data(), buffer.data() + buffer.size());
+        }
+        auto used = static_cast<std::size_t>(this->pptr() - this->pbase());
+        while (static_cast<std::size_t>(this->epptr() - this->pptr()) < chars) {
+            auto buffer = Output.template Grow<TChar>(used);
+            this->setp(buffer.data(), buffer.data() + buffer.size());
+            this->pbump(static_cast<int>(used));
+        }
+        auto out = reinterpret_cast<std::byte*>(this->pptr());
+        for (auto&& segment : buffers.Segments()) {
+            std::memcpy(out, segment.Data.data(), segment.Data.size());
+            out += segment.Data.size();
+        }
+        this->pbump(static_cast<int>(chars));
+        buffers.Clear();
+    }
+
+    void TrimOutput() noexcept {
+        if (this->pptr() == this->pbase()) {
+            this->setp(nullptr, nullptr);
+            Output.Release();
+        }
+    }
+
+    void Restore(TBasicFdStreamBuf& streamBuf) noexcept {
+        this->setg(streamBuf.eback(), streamBuf.gptr(), streamBuf.egptr());
+        this->setp(streamBuf.pbase(), streamBuf.epptr());
+        this->pbump(static_cast<int>(streamBuf.pptr() - streamBuf.pbase()));
+        streamBuf.setg(nullptr, nullptr, nullptr);
+        streamBuf.setp(nullptr, nullptr);
+    }
+
 private:
-    std::unique_ptr<TChar[]> Buffer;
-    std::size_t Size;
+    NInternal::TPooledBuffer Input;
+    NInternal::TPooledBuffer Output;
     TBasicSharedFd<TCloser> Fd;
+    [[no_unique_address]] NInternal::TIoRecorder Recorder;
+    bool Blocked;
 };
 
 template <typename TChar, typename TCloser = TFdCloser>
 class TBasicIFdStream : public std::basic_istream<TChar> {
 public:
-    explicit TBasicIFdStream(TBasicSharedFd<TCloser> fd)
+    explicit TBasicIFdStream(TBasicSharedFd<TCloser> fd, std::size_t buffSize = NInternal::BuffSize())
         : std::basic_istream<TChar>{nullptr}
-        , StreamBuf{std::move(fd), NInternal::BuffSize()}
+        , StreamBuf{std::move(fd), buffSize}
     {
         this->rdbuf(std::addressof(StreamBuf));
     }
@@ -314,6 +645,26 @@ public:
         return StreamBuf.GetFd();
     }
 
+    // returns the stream buffers to the shared pool if they're drained, e.g.
+    // before the fd goes idle
+    void Trim() noexcept {
+        StreamBuf.Trim();
+    }
+
+    // applies to the buffers taken from now on
+    void SetBufferSize(std::size_t buffSize) noexcept {
+        StreamBuf.SetBufferSize(buffSize);
+    }
+
+    [[nodiscard]]
+    TIoCounters GetCounters() const noexcept {
+        return StreamBuf.GetCounters();
+    }
+
+    NInternal::TIoRecorder& GetRecorder() noexcept {
+        return StreamBuf.GetRecorder();
+    }
+
 private:
     TBasicIFdStreamBuf<TChar, TCloser> StreamBuf;
 };
@@ -321,9 +672,9 @@ private:
 template <typename TChar, typename TCloser = TFdCloser>
 class TBasicOFdStream : public std::basic_ostream<TChar> {
 public:
-    explicit TBasicOFdStream(TBasicSharedFd<TCloser> fd)
+    explicit TBasicOFdStream(TBasicSharedFd<TCloser> fd, std::size_t buffSize = NInternal::BuffSize())
         : std::basic_ostream<TChar>{nullptr}
-        , StreamBuf{std::move(fd), NInternal::BuffSize()}
+        , StreamBuf{std::move(fd), buffSize}
     {
         this->rdbuf(std::addressof(StreamBuf));
     }
@@ -365,6 +716,34 @@ public:
         return StreamBuf.GetFd();
     }
 
+    // returns the stream buffers to the shared pool if they're drained, e.g.
+    // before the fd goes idle
+    void Trim() noexcept {
+        StreamBuf.Trim();
+    }
+
+    // applies to the buffers taken from now on
+    void SetBufferSize(std::size_t buffSize) noexcept {
+        StreamBuf.SetBufferSize(buffSize);
+    }
+
+    // a failed write sets badbit, the list keeps what's left of it
+    TBasicOFdStream& WriteBuffers(TBufferList& buffers) {
+        if (!StreamBuf.WriteBuffers(buffers)) {
+            this->setstate(std::ios_base::badbit);
+        }
+        return *this;
+    }
+
+    [[nodiscard]]
+    TIoCounters GetCounters() const noexcept {
+        return StreamBuf.GetCounters();
+    }
+
+    NInternal::TIoRecorder& GetRecorder() noexcept {
+        return StreamBuf.GetRecorder();
+    }
+
 private:
     TBasicOFdStreamBuf<TChar, TCloser> StreamBuf;
 };
@@ -372,9 +751,9 @@ private:
 template <typename TChar, typename TCloser = TFdCloser>
 class TBasicFdStream : public std::basic_iostream<TChar> {
 public:
-    explicit TBasicFdStream(TBasicSharedFd<TCloser> fd)
+    explicit TBasicFdStream(TBasicSharedFd<TCloser> fd, std::size_t buffSize = NInternal::BuffSize())
         : std::basic_iostream<TChar>{nullptr}
-        , StreamBuf{std::move(fd), NInternal::BuffSize()}
+        , StreamBuf{std::move(fd), buffSize}
     {
         this->rdbuf(std::addressof(StreamBuf));
     }
@@ -416,6 +795,51 @@ public:
         return StreamBuf.GetFd();
     }
 
+    // returns the stream buffers to the shared pool if they're drained, e.g.
+    // before the fd goes idle
+    void Trim() noexcept {
+        StreamBuf.Trim();
+    }
+
+    // applies to the buffers taken from now on
+    void SetBufferSize(std::size_t buffSize) noexcept {
+        StreamBuf.SetBufferSize(buffSize);
+    }
+
+    // A failed write sets badbit, the list keeps what's left of it. Output
+    // that would block isn't a failure, it stays buffered, see WouldBlock
+    TBasicFdStream& WriteBuffers(TBufferList& buffers) {
+        if (!StreamBuf.WriteBuffers(buffers)) {
+            this->setstate(std::ios_base::badbit);
+        }
+        return *this;
+    }
+
+    // Whether the last read or write stopped because a non-blocking fd wasn't
+    // ready. A read fails then and output stays buffered
+    [[nodiscard]]
+    bool WouldBlock() const noexcept {
+        return StreamBuf.WouldBlock();
+    }
+
+    [[nodiscard]]
+    std::size_t Unflushed() const noexcept {
+        return StreamBuf.Unflushed();
+    }
+
+    void DiscardOutput() noexcept {
+        StreamBuf.DiscardOutput();
+    }
+
+    [[nodiscard]]
+    TIoCounters GetCounters() const noexcept {
+        return StreamBuf.GetCounters();
+    }
+
+    NInternal::TIoRecorder& GetRecorder() noexcept {
+        return StreamBuf.GetRecorder();
+    }
+
 private:
     TBasicFdStreamBuf<TChar, TCloser> StreamBuf;
 };
@@ -0,0 +1,34 @@
+#include "io_counters.h"
+
+TIoCounters& TIoCounters::operator+=(const TIoCounters& other) noexcept {
+    BytesIn += other.BytesIn;
+    BytesOut += other.BytesOut;
+    Reads += other.Reads;
+    Writes += other.Writes;
+    ShortReads += other.ShortReads;
+    ShortWrites += other.ShortWrites;
+    Again += other.Again;
+    Blocked += other.Blocked;
+    return *this;
+}
+
+#ifdef K_IO_COUNTERS
+void NInternal::TIoRecorder::Record(
+    bool write, std::size_t requested, std::ptrdiff_t res, std::chrono::steady_clock::time_point start) noexcept
+{
+    // errno of the call is left for the caller
+    auto error = errno;
+    Counters.Blocked += std::chrono::steady_clock::now() - start;
+    ++(write ? Counters.Writes : Counters.Reads);
+    if (res >= 0) {
+        (write ? Counters.BytesOut : Counters.BytesIn) += static_cast<std::uint64_t>(res);
+        // end of file is not a short read
+        if (res > 0 && static_cast<std::size_t>(res) < requested) {
+            ++(write ? Counters.ShortWrites : Counters.ShortReads);
+        }
+    } else if (error == EAGAIN || error == EWOULDBLOCK) {
+        ++Counters.Again;
+    }
+    errno = error;
+}
+#endif
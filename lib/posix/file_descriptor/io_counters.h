@@ -0,0 +1,79 @@
+#pragma once
+
+#include <cerrno>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+// Syscall level statistics of a stream, collected only when the library is
+// built with K_IO_COUNTERS and always zero otherwise
+struct TIoCounters {
+    std::uint64_t BytesIn = 0;
+    std::uint64_t BytesOut = 0;
+    std::uint64_t Reads = 0;
+    std::uint64_t Writes = 0;
+    // calls that transferred less than was asked for
+    std::uint64_t ShortReads = 0;
+    std::uint64_t ShortWrites = 0;
+    // calls failed with EAGAIN on a non-blocking fd
+    std::uint64_t Again = 0;
+    // wall time spent inside read and write calls
+    std::chrono::nanoseconds Blocked{0};
+
+    TIoCounters& operator+=(const TIoCounters& other) noexcept;
+};
+
+namespace NInternal {
+#ifdef K_IO_COUNTERS
+    inline constexpr bool IoCountersEnabled = true;
+#else
+    inline constexpr bool IoCountersEnabled = false;
+#endif
+
+    // Wraps read and write calls of a stream, it's an empty class that only
+    // forwards the calls when counters are disabled
+    class TIoRecorder {
+    public:
+        template <typename TOp>
+        auto Read(std::size_t requested, TOp&& op) {
+#ifdef K_IO_COUNTERS
+            auto start = std::chrono::steady_clock::now();
+            auto res = op();
+            Record(false, requested, static_cast<std::ptrdiff_t>(res), start);
+            return res;
+#else
+            static_cast<void>(requested);
+            return op();
+#endif
+        }
+
+        template <typename TOp>
+        auto Write(std::size_t requested, TOp&& op) {
+#ifdef K_IO_COUNTERS
+            auto start = std::chrono::steady_clock::now();
+            auto res = op();
+            Record(true, requested, static_cast<std::ptrdiff_t>(res), start);
+            return res;
+#else
+            static_cast<void>(requested);
+            return op();
+#endif
+        }
+
+        [[nodiscard]]
+        TIoCounters Get() const noexcept {
+#ifdef K_IO_COUNTERS
+            return Counters;
+#else
+            return {};
+#endif
+        }
+
+    private:
+#ifdef K_IO_COUNTERS
+        void Record(bool write, std::size_t requested, std::ptrdiff_t res, std::chrono::steady_clock::time_point start) noexcept;
+
+        TIoCounters Counters;
+#endif
+    };
+}
@@ -0,0 +1,251 @@
+#include "io_uring.h"
+
+#include <util/exception/exception.h>
+
+#include <system_error>
+
+#ifdef __linux__
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cstring>
+
+namespace {
+    int Setup(unsigned entries, io_uring_params& params) {
+        return static_cast<int>(syscall(__NR_io_uring_setup, entries, std::addressof(params)));
+    }
+
+    int Enter(int fd, unsigned toSubmit, unsigned minComplete, unsigned flags, const void* arg, std::size_t argSize) {
+        return static_cast<int>(syscall(__NR_io_uring_enter, fd, toSubmit, minComplete, flags, arg, argSize));
+    }
+
+    template <typename T>
+    T* At(void* base, std::size_t offset) {
+        return reinterpret_cast<T*>(static_cast<char*>(base) + offset);
+    }
+
+    void* Map(int fd, std::size_t size, off_t offset) {
+        auto ptr = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, offset);
+        if (ptr == MAP_FAILED) {
+            throw std::system_error{std::error_code{errno, std::system_category()}};
+        }
+        return ptr;
+    }
+
+    unsigned LoadAcquire(unsigned* ptr) {
+        return std::atomic_ref<unsigned>{*ptr}.load(std::memory_order_acquire);
+    }
+
+    void StoreRelease(unsigned* ptr, unsigned value) {
+        std::atomic_ref<unsigned>{*ptr}.store(value, std::memory_order_release);
+    }
+
+    bool Probe() noexcept {
+        io_uring_params params{};
+        int fd = Setup(2, params);
+        if (fd < 0) {
+            return false;
+        }
+        close(fd);
+        return (params.features & IORING_FEAT_EXT_ARG) != 0;
+    }
+}
+
+bool TIoUring::TCompletion::More() const noexcept {
+    return (Flags & IORING_CQE_F_MORE) != 0;
+}
+
+TIoUring::TIoUring(unsigned entries)
+    : Fd{}
+    , Entries{0}
+    , Features{0}
+    , SqRing{nullptr}
+    , SqRingSize{0}
+    , CqRing{nullptr}
+    , CqRingSize{0}
+    , Sqes{nullptr}
+    , SqesSize{0}
+    , Tail{0}
+    , ToSubmit{0}
+{
+    io_uring_params params{};
+    Fd.Reset(Setup(entries, params));
+    if (!Fd) {
+        throw std::system_error{std::error_code{errno, std::system_category()}};
+    }
+    Entries = params.sq_entries;
+    Features = params.features;
+
+    SqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    CqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    SqesSize = params.sq_entries * sizeof(io_uring_sqe);
+    try {
+        if (Features & IORING_FEAT_SINGLE_MMAP) {
+            SqRingSize = CqRingSize = std::max(SqRingSize, CqRingSize);
+            SqRing = Map(Fd.Get(), SqRingSize, IORING_OFF_SQ_RING);
+            CqRing = SqRing;
+        } else {
+            SqRing = Map(Fd.Get(), SqRingSize, IORING_OFF_SQ_RING);
+            CqRing = Map(Fd.Get(), CqRingSize, IORING_OFF_CQ_RING);
+        }
+        Sqes = Map(Fd.Get(), SqesSize, IORING_OFF_SQES);
+    } catch (...) {
+        Unmap();
+        throw;
+    }
+
+    SqHead = At<unsigned>(SqRing, params.sq_off.head);
+    SqTail = At<unsigned>(SqRing, params.sq_off.tail);
+    SqMask = At<unsigned>(SqRing, params.sq_off.ring_mask);
+    SqArray = At<unsigned>(SqRing, params.sq_off.array);
+    CqHead = At<unsigned>(CqRing, params.cq_off.head);
+    CqTail = At<unsigned>(CqRing, params.cq_off.tail);
+    CqMask = At<unsigned>(CqRing, params.cq_off.ring_mask);
+    Cqes = At<io_uring_cqe>(CqRing, params.cq_off.cqes);
+    Tail = *SqTail;
+}
+
+TIoUring::~TIoUring() {
+    Unmap();
+}
+
+void TIoUring::Unmap() noexcept {
+    if (Sqes != nullptr) {
+        munmap(Sqes, SqesSize);
+        Sqes = nullptr;
+    }
+    if (CqRing != nullptr && CqRing != SqRing) {
+        munmap(CqRing, CqRingSize);
+    }
+    CqRing = nullptr;
+    if (SqRing != nullptr) {
+        munmap(SqRing, SqRingSize);
+        SqRing = nullptr;
+    }
+}
+
+bool TIoUring::Supported() noexcept {
+    static const bool supported = Probe();
+    return supported;
+}
+
+void TIoUring::PreparePoll(int fd, unsigned events, bool multishot, std::uint64_t userData) {
+    auto sqe = static_cast<io_uring_sqe*>(NextEntry());
+    sqe->opcode = IORING_OP_POLL_ADD;
+    sqe->fd = fd;
+    sqe->poll32_events = events;
+    sqe->len = multishot ? IORING_POLL_ADD_MULTI : 0;
+    sqe->user_data = userData;
+}
+
+void TIoUring::PreparePollRemove(std::uint64_t target, std::uint64_t userData) {
+    auto sqe = static_cast<io_uring_sqe*>(NextEntry());
+    sqe->opcode = IORING_OP_POLL_REMOVE;
+    sqe->fd = -1;
+    sqe->addr = target;
+    sqe->user_data = userData;
+}
+
+std::size_t TIoUring::Submit() {
+    if (ToSubmit == 0) {
+        return 0;
+    }
+    return Enter(true, 0, std::chrono::milliseconds::zero());
+}
+
+void TIoUring::Wait(std::chrono::milliseconds timeout) {
+    Enter(false, 1, timeout);
+}
+
+std::size_t TIoUring::Reap(std::span<TCompletion> completions) {
+    auto head = *CqHead;
+    auto tail = LoadAcquire(CqTail);
+    auto cqes = static_cast<io_uring_cqe*>(Cqes);
+    std::size_t count = 0;
+    for (; head != tail && count < completions.size(); ++head) {
+        auto& cqe = cqes[head & *CqMask];
+        completions[count++] = TCompletion{cqe.user_data, cqe.res, cqe.flags};
+    }
+    StoreRelease(CqHead, head);
+    return count;
+}
+
+void* TIoUring::NextEntry() {
+    if (Tail - LoadAcquire(SqHead) >= Entries) {
+        Submit();
+        if (Tail - LoadAcquire(SqHead) >= Entries) {
+            throw TException{"io_uring submission queue is full"};
+        }
+    }
+    auto index = Tail & *SqMask;
+    auto sqe = static_cast<io_uring_sqe*>(Sqes) + index;
+    std::memset(sqe, 0, sizeof(io_uring_sqe));
+    SqArray[index] = index;
+    ++Tail;
+    ++ToSubmit;
+    return sqe;
+}
+
+std::size_t TIoUring::Enter(bool submit, unsigned minComplete, std::chrono::milliseconds timeout) {
+    unsigned flags = minComplete > 0 ? IORING_ENTER_GETEVENTS : 0;
+    io_uring_getevents_arg arg{};
+    __kernel_timespec ts{};
+    if (minComplete > 0 && timeout.count() >= 0) {
+        ts.tv_sec = timeout.count() / 1000;
+        ts.tv_nsec = (timeout.count() % 1000) * 1000000;
+        arg.ts = reinterpret_cast<std::uint64_t>(std::addressof(ts));
+        flags |= IORING_ENTER_EXT_ARG;
+    }
+    const void* argPtr = (flags & IORING_ENTER_EXT_ARG) ? std::addressof(arg) : nullptr;
+    std::size_t argSize = argPtr != nullptr ? sizeof(arg) : 0;
+
+    unsigned toSubmit = 0;
+    if (submit) {
+        // entries become visible to the kernel only once they are complete
+        StoreRelease(SqTail, Tail);
+        toSubmit = ToSubmit;
+    }
+    int res = ::Enter(Fd.Get(), toSubmit, minComplete, flags, argPtr, argSize);
+    if (res < 0) {
+        if (errno == ETIME || errno == EINTR || errno == EBUSY) {
+            return 0;
+        }
+        throw std::system_error{std::error_code{errno, std::system_category()}};
+    }
+    if (submit) {
+        ToSubmit -= static_cast<unsigned>(res);
+    }
+    return res;
+}
+#else
+bool TIoUring::TCompletion::More() const noexcept {
+    return false;
+}
+
+TIoUring::TIoUring(unsigned) {
+    throw TException{"io_uring is not supported on this platform"};
+}
+
+TIoUring::~TIoUring() = default;
+
+bool TIoUring::Supported() noexcept {
+    return false;
+}
+
+void TIoUring::PreparePoll(int, unsigned, bool, std::uint64_t) {}
+
+void TIoUring::PreparePollRemove(std::uint64_t, std::uint64_t) {}
+
+std::size_t TIoUring::Submit() {
+    return 0;
+}
+
+void TIoUring::Wait(std::chrono::milliseconds) {}
+
+std::size_t TIoUring::Reap(std::span<TCompletion>) {
+    return 0;
+}
+#endif
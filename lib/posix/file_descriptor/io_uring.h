@@ -0,0 +1,81 @@
+#pragma once
+
+#include <posix/file_descriptor/unique_fd.h>
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+// A minimal io_uring ring for readiness polling only: poll and poll remove
+// requests are batched into one submission per wait. Reads and writes stay
+// ordinary syscalls on the ready fds, so it saves registration syscalls, not
+// the I/O ones. It backs EPollBackend::IoUring
+class TIoUring {
+public:
+    struct TCompletion {
+        std::uint64_t UserData = 0;
+        int Result = 0;
+        unsigned Flags = 0;
+
+        // multishot requests keep posting completions while this is set
+        [[nodiscard]]
+        bool More() const noexcept;
+    };
+
+public:
+    explicit TIoUring(unsigned entries);
+
+    TIoUring(const TIoUring&) = delete;
+    TIoUring& operator=(const TIoUring&) = delete;
+
+    ~TIoUring();
+
+    // probes the running kernel once, rings need 5.11+ for waits with timeout
+    [[nodiscard]]
+    static bool Supported() noexcept;
+
+    void PreparePoll(int fd, unsigned events, bool multishot, std::uint64_t userData);
+
+    void PreparePollRemove(std::uint64_t target, std::uint64_t userData);
+
+    // submits everything prepared so far in one syscall
+    std::size_t Submit();
+
+    // only waits for a completion, a negative timeout waits forever. It may
+    // run concurrently with a thread preparing and submitting
+    void Wait(std::chrono::milliseconds timeout);
+
+    std::size_t Reap(std::span<TCompletion> completions);
+
+private:
+    void Unmap() noexcept;
+
+    void* NextEntry();
+
+    std::size_t Enter(bool submit, unsigned minComplete, std::chrono::milliseconds timeout);
+
+private:
+    TUniqueFd Fd;
+    unsigned Entries;
+    unsigned Features;
+
+    void* SqRing;
+    std::size_t SqRingSize;
+    void* CqRing;
+    std::size_t CqRingSize;
+    void* Sqes;
+    std::size_t SqesSize;
+
+    unsigned* SqHead;
+    unsigned* SqTail;
+    unsigned* SqMask;
+    unsigned* SqArray;
+    unsigned* CqHead;
+    unsigned* CqTail;
+    unsigned* CqMask;
+    void* Cqes;
+
+    unsigned Tail;
+    unsigned ToSubmit;
+};
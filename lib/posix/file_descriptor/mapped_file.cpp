@@ -0,0 +1,186 @@
+#include "mapped_file.h"
+
+#include <posix/file_descriptor/unique_fd.h>
+
+#include <util/exception/exception.h>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <system_error>
+#include <utility>
+
+namespace {
+    int AdviceFlag(EMapAdvice advice) {
+        switch (advice) {
+            case EMapAdvice::Normal:
+                return MADV_NORMAL;
+            case EMapAdvice::Sequential:
+                return MADV_SEQUENTIAL;
+            case EMapAdvice::Random:
+                return MADV_RANDOM;
+            case EMapAdvice::WillNeed:
+                return MADV_WILLNEED;
+            case EMapAdvice::DontNeed:
+                return MADV_DONTNEED;
+            case EMapAdvice::HugePage:
+#ifdef MADV_HUGEPAGE
+                return MADV_HUGEPAGE;
+#else
+                return -1;
+#endif
+        }
+        return -1;
+    }
+}
+
+TMappedFile::TMappedFile(const std::filesystem::path& path)
+    : Data{nullptr}
+    , Length{0}
+{
+    TUniqueFd fd{open(path.c_str(), O_RDONLY | O_CLOEXEC)};
+    if (fd.Get() < 0) {
+        throw std::system_error{std::error_code{errno, std::system_category()}, path.string()};
+    }
+    Map(fd.Get());
+}
+
+TMappedFile::TMappedFile(const IFd& fd)
+    : Data{nullptr}
+    , Length{0}
+{
+    Map(fd.Get());
+}
+
+TMappedFile::TMappedFile(TMappedFile&& other) noexcept
+    : Data{std::exchange(other.Data, nullptr)}
+    , Length{std::exchange(other.Length, 0)}
+{}
+
+TMappedFile& TMappedFile::operator=(TMappedFile&& other) noexcept {
+    if (this != std::addressof(other)) {
+        Unmap();
+        Data = std::exchange(other.Data, nullptr);
+        Length = std::exchange(other.Length, 0);
+    }
+    return *this;
+}
+
+TMappedFile::~TMappedFile() {
+    Unmap();
+}
+
+std::string_view TMappedFile::View() const noexcept {
+    return {static_cast<const char*>(Data), Length};
+}
+
+std::span<const std::byte> TMappedFile::Bytes() const noexcept {
+    return {static_cast<const std::byte*>(Data), Length};
+}
+
+std::size_t TMappedFile::Size() const noexcept {
+    return Length;
+}
+
+bool TMappedFile::Advise(EMapAdvice advice) const {
+    return Advise(advice, 0, Length);
+}
+
+bool TMappedFile::Advise(EMapAdvice advice, std::size_t offset, std::size_t length) const {
+    if (offset >= Length || length == 0) {
+        return true;
+    }
+    auto flag = AdviceFlag(advice);
+    if (flag < 0) {
+        return false;
+    }
+    // madvise wants a page aligned start
+    static const auto page = static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+    auto start = offset / page * page;
+    length = std::min(length, Length - offset) + (offset - start);
+    if (madvise(static_cast<char*>(Data) + start, length, flag) < 0) {
+        if (errno == EINVAL) {
+            return false;
+        }
+        throw std::system_error{std::error_code{errno, std::system_category()}};
+    }
+    return true;
+}
+
+void TMappedFile::Map(int fd) {
+    struct stat info{};
+    if (fstat(fd, std::addressof(info)) < 0) {
+        throw std::system_error{std::error_code{errno, std::system_category()}};
+    }
+    if (!S_ISREG(info.st_mode)) {
+        throw TException{"Only regular files can be mapped"};
+    }
+    // an empty mapping isn't allowed, an empty file has an empty view
+    if (info.st_size == 0) {
+        return;
+    }
+    auto length = static_cast<std::size_t>(info.st_size);
+    auto data = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (data == MAP_FAILED) {
+        throw std::system_error{std::error_code{errno, std::system_category()}};
+    }
+    Data = data;
+    Length = length;
+}
+
+void TMappedFile::Unmap() noexcept {
+    if (Data != nullptr) {
+        munmap(Data, Length);
+        Data = nullptr;
+        Length = 0;
+    }
+}
+
+TMappedStreamBuf::TMappedStreamBuf(std::string_view content) noexcept {
+    // the get area is never written to, streambuf just has no const interface
+    auto start = const_cast<char*>(content.data());
+    this->setg(start, start, start + content.size());
+}
+
+TMappedStreamBuf::pos_type TMappedStreamBuf::seekoff(
+    off_type offset, std::ios_base::seekdir dir, std::ios_base::openmode which)
+{
+    if (!(which & std::ios_base::in)) {
+        return pos_type(off_type(-1));
+    }
+    off_type base = 0;
+    if (dir == std::ios_base::cur) {
+        base = this->gptr() - this->eback();
+    } else if (dir == std::ios_base::end) {
+        base = this->egptr() - this->eback();
+    }
+    auto position = base + offset;
+    if (position < 0 || position > this->egptr() - this->eback()) {
+        return pos_type(off_type(-1));
+    }
+    this->setg(this->eback(), this->eback() + position, this->egptr());
+    return pos_type(position);
+}
+
+TMappedStreamBuf::pos_type TMappedStreamBuf::seekpos(pos_type position, std::ios_base::openmode which) {
+    return seekoff(off_type(position), std::ios_base::beg, which);
+}
+
+TMappedFileStream::TMappedFileStream(const std::filesystem::path& path)
+    : TMappedFileStream{TMappedFile{path}}
+{}
+
+TMappedFileStream::TMappedFileStream(TMappedFile&& file)
+    : std::istream{nullptr}
+    , File{std::move(file)}
+    , StreamBuf{File.View()}
+{
+    this->rdbuf(std::addressof(StreamBuf));
+}
+
+const TMappedFile& TMappedFileStream::GetFile() const noexcept {
+    return File;
+}
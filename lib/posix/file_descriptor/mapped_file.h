@@ -0,0 +1,92 @@
+#pragma once
+
+#include <posix/file_descriptor/fd.h>
+
+#include <cstddef>
+#include <filesystem>
+#include <istream>
+#include <span>
+#include <streambuf>
+#include <string_view>
+
+enum class EMapAdvice : unsigned char {
+    Normal,
+    Sequential,
+    Random,
+    WillNeed,
+    DontNeed,
+    // only honoured by kernels with transparent huge pages for files
+    HugePage
+};
+
+// A whole file mapped read-only and privately, so the content is read without
+// copying it out of the page cache. The file must not be truncated while it's
+// mapped, reading the lost pages raises SIGBUS
+class TMappedFile {
+public:
+    explicit TMappedFile(const std::filesystem::path& path);
+
+    // the fd may be closed afterwards, the mapping keeps the file open
+    explicit TMappedFile(const IFd& fd);
+
+    TMappedFile(TMappedFile&& other) noexcept;
+
+    TMappedFile& operator=(TMappedFile&& other) noexcept;
+
+    TMappedFile(const TMappedFile&) = delete;
+    TMappedFile& operator=(const TMappedFile&) = delete;
+
+    ~TMappedFile();
+
+    [[nodiscard]]
+    std::string_view View() const noexcept;
+
+    [[nodiscard]]
+    std::span<const std::byte> Bytes() const noexcept;
+
+    [[nodiscard]]
+    std::size_t Size() const noexcept;
+
+    // Hints the kernel how the range is going to be read, false is returned
+    // if the hint isn't supported
+    bool Advise(EMapAdvice advice) const;
+
+    bool Advise(EMapAdvice advice, std::size_t offset, std::size_t length) const;
+
+private:
+    void Map(int fd);
+
+    void Unmap() noexcept;
+
+private:
+    void* Data;
+    std::size_t Length;
+};
+
+// Reads the mapped memory in place, seeking is supported
+class TMappedStreamBuf : public std::streambuf {
+public:
+    explicit TMappedStreamBuf(std::string_view content) noexcept;
+
+protected:
+    pos_type seekoff(off_type offset, std::ios_base::seekdir dir, std::ios_base::openmode which) override;
+
+    pos_type seekpos(pos_type position, std::ios_base::openmode which) override;
+};
+
+class TMappedFileStream : public std::istream {
+public:
+    explicit TMappedFileStream(const std::filesystem::path& path);
+
+    explicit TMappedFileStream(TMappedFile&& file);
+
+    TMappedFileStream(const TMappedFileStream&) = delete;
+    TMappedFileStream& operator=(const TMappedFileStream&) = delete;
+
+    [[nodiscard]]
+    const TMappedFile& GetFile() const noexcept;
+
+private:
+    TMappedFile File;
+    TMappedStreamBuf StreamBuf;
+};
@@ -2,6 +2,16 @@
 
 #include <unistd.h>
 #include <fcntl.h>
+#ifdef __linux__
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <sys/signalfd.h>
+#include <sys/timerfd.h>
+#endif
+
+#include <algorithm>
+#include <csignal>
+#include <system_error>
 
 #include <cstdio>
 
@@ -49,3 +59,118 @@ std::pair<TSharedFd, TSharedFd> NInternal::PtMasterSlave() {
     }
     return {TSharedFd{master}, TSharedFd{slave}};
 }
+
+std::pair<TSharedFd, TSharedFd> NInternal::EventFd() {
+#ifdef __linux__
+    int fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (fd < 0) {
+        throw std::system_error{std::error_code{errno, std::system_category()}};
+    }
+    TSharedFd shared{fd};
+    return {shared, shared};
+#else
+    auto [in, out] = Pipe();
+    SetNonBlocking(in);
+    SetNonBlocking(out);
+    return {TSharedFd{std::move(in)}, TSharedFd{std::move(out)}};
+#endif
+}
+
+void NInternal::SetNonBlocking(const IFd& fd, bool nonBlocking) {
+    int flags = fcntl(fd.Get(), F_GETFL);
+    if (flags < 0) {
+        throw std::system_error{std::error_code{errno, std::system_category()}};
+    }
+    flags = nonBlocking ? flags | O_NONBLOCK : flags & ~O_NONBLOCK;
+    if (fcntl(fd.Get(), F_SETFL, flags) < 0) {
+        throw std::system_error{std::error_code{errno, std::system_category()}};
+    }
+}
+
+#ifndef __linux__
+namespace {
+    [[noreturn]]
+    void Unsupported() {
+        throw TException{"The fd type is supported on linux only"};
+    }
+}
+#endif
+
+TUniqueFd NInternal::TimerFd(std::chrono::nanoseconds initial, std::chrono::nanoseconds interval) {
+#ifdef __linux__
+    TUniqueFd fd{timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK)};
+    if (fd.Get() < 0) {
+        throw std::system_error{std::error_code{errno, std::system_category()}};
+    }
+    auto toTimespec = [](std::chrono::nanoseconds value) {
+        auto seconds = std::chrono::duration_cast<std::chrono::seconds>(value);
+        return timespec{static_cast<time_t>(seconds.count()), static_cast<long>((value - seconds).count())};
+    };
+    // a zero initial value would disarm the timer
+    itimerspec spec{toTimespec(interval), toTimespec(std::max(initial, std::chrono::nanoseconds{1}))};
+    if (timerfd_settime(fd.Get(), 0, std::addressof(spec), nullptr) < 0) {
+        throw std::system_error{std::error_code{errno, std::system_category()}};
+    }
+    return fd;
+#else
+    Unsupported();
+#endif
+}
+
+std::uint64_t NInternal::ReadTimerFd(const IFd& fd) {
+    std::uint64_t expirations = 0;
+    if (read(fd.Get(), std::addressof(expirations), sizeof(expirations)) < 0) {
+        if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            return 0;
+        }
+        throw std::system_error{std::error_code{errno, std::system_category()}};
+    }
+    return expirations;
+}
+
+TUniqueFd NInternal::SignalFd(std::span<const int> signals) {
+#ifdef __linux__
+    sigset_t mask;
+    sigemptyset(std::addressof(mask));
+    for (auto signal : signals) {
+        sigaddset(std::addressof(mask), signal);
+    }
+    if (int error = pthread_sigmask(SIG_BLOCK, std::addressof(mask), nullptr); error != 0) {
+        throw std::system_error{std::error_code{error, std::system_category()}};
+    }
+    TUniqueFd fd{signalfd(-1, std::addressof(mask), SFD_CLOEXEC | SFD_NONBLOCK)};
+    if (fd.Get() < 0) {
+        throw std::system_error{std::error_code{errno, std::system_category()}};
+    }
+    return fd;
+#else
+    Unsupported();
+#endif
+}
+
+int NInternal::ReadSignalFd(const IFd& fd) {
+#ifdef __linux__
+    signalfd_siginfo info{};
+    if (read(fd.Get(), std::addressof(info), sizeof(info)) < 0) {
+        if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            return 0;
+        }
+        throw std::system_error{std::error_code{errno, std::system_category()}};
+    }
+    return static_cast<int>(info.ssi_signo);
+#else
+    Unsupported();
+#endif
+}
+
+TUniqueFd NInternal::Inotify() {
+#ifdef __linux__
+    TUniqueFd fd{inotify_init1(IN_CLOEXEC | IN_NONBLOCK)};
+    if (fd.Get() < 0) {
+        throw std::system_error{std::error_code{errno, std::system_category()}};
+    }
+    return fd;
+#else
+    Unsupported();
+#endif
+}
@@ -1,5 +1,11 @@
+#pragma once
+
 #include <posix/file_descriptor/shared_fd.h>
 
+#include <chrono>
+#include <cstdint>
+#include <span>
+
 namespace NInternal {
     std::size_t BuffSize();
 
@@ -10,4 +16,28 @@ namespace NInternal {
     std::pair<TUniqueFd, TUniqueFd> Pipe();
 
     std::pair<TSharedFd, TSharedFd> PtMasterSlave();
+
+    // Non-blocking read and write ends of a counter used for wakeups: the same
+    // eventfd on linux and a pipe elsewhere
+    std::pair<TSharedFd, TSharedFd> EventFd();
+
+    void SetNonBlocking(const IFd& fd, bool nonBlocking = true);
+
+    // Linux only fds to multiplex with sockets, all of them are non-blocking
+
+    // fires after initial and then every interval, a zero interval fires once
+    TUniqueFd TimerFd(std::chrono::nanoseconds initial, std::chrono::nanoseconds interval = {});
+
+    // expirations since the last call, 0 if there were none
+    std::uint64_t ReadTimerFd(const IFd& fd);
+
+    // the signals are blocked in the calling thread, so it's best made before
+    // other threads are started and inherit the mask
+    TUniqueFd SignalFd(std::span<const int> signals);
+
+    // the next signal received, 0 if there is none
+    int ReadSignalFd(const IFd& fd);
+
+    // watches are added with inotify_add_watch
+    TUniqueFd Inotify();
 }
@@ -0,0 +1,183 @@
+#include "transfer.h"
+
+#include <util/exception/exception.h>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/sendfile.h>
+#endif
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <system_error>
+
+namespace {
+    // the most sendfile and splice move in one call
+    constexpr std::size_t MaxChunk = 0x7ffff000;
+
+    [[noreturn, maybe_unused]]
+    void Unsupported() {
+        throw TException{"Zero-copy transfers are supported on linux only"};
+    }
+
+    [[noreturn]]
+    void ThrowErrno() {
+        throw std::system_error{std::error_code{errno, std::system_category()}};
+    }
+
+    bool IsBlocked() noexcept {
+        return errno == EAGAIN || errno == EWOULDBLOCK;
+    }
+
+#ifdef __linux__
+    // splice reports EAGAIN for either side, poll tells which one isn't ready
+    ETransfer BlockedSide(const IFd& out) noexcept {
+        pollfd fd{out.Get(), POLLOUT, 0};
+        return poll(std::addressof(fd), 1, 0) == 1 && (fd.revents & POLLOUT) ? ETransfer::InputBlocked : ETransfer::OutputBlocked;
+    }
+#endif
+}
+
+TTransferResult SendFile(const IFd& out, const IFd& file, std::uint64_t& offset, std::size_t length) {
+#ifdef __linux__
+    std::size_t total = 0;
+    while (total < length) {
+        auto position = static_cast<off_t>(offset);
+        auto sent = sendfile(out.Get(), file.Get(), std::addressof(position), std::min(length - total, MaxChunk));
+        if (sent < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (IsBlocked()) {
+                return {total, ETransfer::OutputBlocked};
+            }
+            ThrowErrno();
+        }
+        if (sent == 0) {
+            return {total, ETransfer::EndOfInput};
+        }
+        offset += static_cast<std::uint64_t>(sent);
+        total += static_cast<std::size_t>(sent);
+    }
+    return {total, ETransfer::Complete};
+#else
+    static_cast<void>(out);
+    static_cast<void>(file);
+    static_cast<void>(offset);
+    static_cast<void>(length);
+    Unsupported();
+#endif
+}
+
+TTransferResult Splice(const IFd& in, const IFd& out, std::size_t length) {
+#ifdef __linux__
+    std::size_t total = 0;
+    while (total < length) {
+        auto moved = splice(in.Get(), nullptr, out.Get(), nullptr, std::min(length - total, MaxChunk), SPLICE_F_MOVE);
+        if (moved < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (IsBlocked()) {
+                return {total, BlockedSide(out)};
+            }
+            ThrowErrno();
+        }
+        if (moved == 0) {
+            return {total, ETransfer::EndOfInput};
+        }
+        total += static_cast<std::size_t>(moved);
+    }
+    return {total, ETransfer::Complete};
+#else
+    static_cast<void>(in);
+    static_cast<void>(out);
+    static_cast<void>(length);
+    Unsupported();
+#endif
+}
+
+TSplicer::TSplicer(std::size_t pipeSize)
+    : ReadEnd{}
+    , WriteEnd{}
+    , Capacity{0}
+    , Buffered{0}
+{
+#ifdef __linux__
+    std::array<int, 2> fds{};
+    if (pipe2(fds.data(), O_CLOEXEC | O_NONBLOCK) < 0) {
+        ThrowErrno();
+    }
+    ReadEnd = TUniqueFd{fds[0]};
+    WriteEnd = TUniqueFd{fds[1]};
+    if (pipeSize > 0 && fcntl(WriteEnd.Get(), F_SETPIPE_SZ, static_cast<int>(pipeSize)) < 0) {
+        ThrowErrno();
+    }
+    auto capacity = fcntl(WriteEnd.Get(), F_GETPIPE_SZ);
+    if (capacity < 0) {
+        ThrowErrno();
+    }
+    Capacity = static_cast<std::size_t>(capacity);
+#else
+    static_cast<void>(pipeSize);
+    Unsupported();
+#endif
+}
+
+TTransferResult TSplicer::Transfer(const IFd& in, const IFd& out, std::size_t length) {
+#ifdef __linux__
+    std::size_t total = 0;
+    while (total < length) {
+        if (Buffered == 0) {
+            // the pipe is only written here, so a full pipe never blocks the fill
+            auto filled = splice(
+                in.Get(), nullptr, WriteEnd.Get(), nullptr,
+                std::min(length - total, Capacity), SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+            if (filled < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                if (IsBlocked()) {
+                    return {total, ETransfer::InputBlocked};
+                }
+                ThrowErrno();
+            }
+            if (filled == 0) {
+                return {total, ETransfer::EndOfInput};
+            }
+            Buffered = static_cast<std::size_t>(filled);
+        }
+
+        auto drained = splice(
+            ReadEnd.Get(), nullptr, out.Get(), nullptr,
+            std::min(length - total, Buffered), SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+        if (drained < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (IsBlocked()) {
+                return {total, ETransfer::OutputBlocked};
+            }
+            ThrowErrno();
+        }
+        if (drained == 0) {
+            return {total, ETransfer::OutputBlocked};
+        }
+        Buffered -= static_cast<std::size_t>(drained);
+        total += static_cast<std::size_t>(drained);
+    }
+    return {total, ETransfer::Complete};
+#else
+    static_cast<void>(in);
+    static_cast<void>(out);
+    static_cast<void>(length);
+    Unsupported();
+#endif
+}
+
+std::size_t TSplicer::Pending() const noexcept {
+    return Buffered;
+}
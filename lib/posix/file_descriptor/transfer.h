@@ -0,0 +1,53 @@
+#pragma once
+
+#include <posix/file_descriptor/unique_fd.h>
+
+#include <cstddef>
+#include <cstdint>
+
+// Zero-copy transfers between fds, the data doesn't pass through user space.
+// A stream's buffered output must be flushed before its fd is written to.
+// They are supported on linux only
+
+enum class ETransfer : unsigned char {
+    // the requested length has been transferred
+    Complete,
+    // a non-blocking input has no data, the transfer resumes once it's readable
+    InputBlocked,
+    // a non-blocking output is full, the transfer resumes once it's writable
+    OutputBlocked,
+    // the input ended first
+    EndOfInput
+};
+
+struct TTransferResult {
+    std::size_t Bytes;
+    ETransfer Status;
+};
+
+// From a file to any fd with sendfile, the offset is advanced by the bytes sent
+TTransferResult SendFile(const IFd& out, const IFd& file, std::uint64_t& offset, std::size_t length);
+
+// Between fds one of which is a pipe, e.g. subprocess output and a socket
+TTransferResult Splice(const IFd& in, const IFd& out, std::size_t length);
+
+// Between fds none of which is a pipe, through a pipe it owns. Data read
+// while the output was blocked stays in the pipe and is written first by
+// the next transfer, so a proxy keeps one splicer per direction
+class TSplicer {
+public:
+    // 0 keeps the system pipe size
+    explicit TSplicer(std::size_t pipeSize = 0);
+
+    TTransferResult Transfer(const IFd& in, const IFd& out, std::size_t length);
+
+    // bytes read but not written yet
+    [[nodiscard]]
+    std::size_t Pending() const noexcept;
+
+private:
+    TUniqueFd ReadEnd;
+    TUniqueFd WriteEnd;
+    std::size_t Capacity;
+    std::size_t Buffered;
+};
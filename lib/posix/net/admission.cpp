@@ -0,0 +1,196 @@
+#include "admission.h"
+
+#include <util/exception/exception.h>
+
+#include <netinet/in.h>
+
+#include <cmath>
+#include <cstring>
+#include <string_view>
+
+TTokenBuckets::TTokenBuckets(double rate, double burst, std::size_t maxPeers)
+    : Rate{rate}
+    , Burst{burst}
+    , MaxPeers{maxPeers}
+    , Mutex{}
+    , Buckets{}
+    , Overflow{burst, TClock::time_point{}}
+    , LastSweep{}
+{
+    if (Rate < 0 || Burst < 1) {
+        throw TException{"Token bucket needs a non-negative rate and a burst of at least 1"};
+    }
+}
+
+bool TTokenBuckets::TryAcquire(const TSocketAddress& peer, TClock::time_point now) {
+    if (Rate == 0) {
+        return true;
+    }
+    TKey key{};
+    key[0] = static_cast<std::byte>(peer.GetType());
+    switch (peer.GetType()) {
+        case ESocket::IP: {
+            auto& address = peer.Address<sockaddr_in>().sin_addr;
+            std::memcpy(key.data() + 1, std::addressof(address), sizeof(address));
+            break;
+        }
+        case ESocket::IP6: {
+            auto& address = peer.Address<sockaddr_in6>().sin6_addr;
+            std::memcpy(key.data() + 1, std::addressof(address), sizeof(address));
+            break;
+        }
+        default:
+            return true;
+    }
+
+    std::lock_guard lock{Mutex};
+    auto it = Buckets.find(key);
+    if (it == Buckets.end()) {
+        if (Buckets.size() >= MaxPeers) {
+            Sweep(now);
+            if (Buckets.size() >= MaxPeers) {
+                return Take(Overflow, now);
+            }
+        }
+        it = Buckets.emplace(key, TBucket{Burst, now}).first;
+    }
+    return Take(it->second, now);
+}
+
+std::size_t TTokenBuckets::THash::operator()(const TKey& key) const noexcept {
+    return std::hash<std::string_view>{}(std::string_view{reinterpret_cast<const char*>(key.data()), key.size()});
+}
+
+void TTokenBuckets::Refill(TBucket& bucket, TClock::time_point now) const noexcept {
+    std::chrono::duration<double> elapsed = now - bucket.Updated;
+    bucket.Tokens = std::min(Burst, bucket.Tokens + elapsed.count() * Rate);
+    bucket.Updated = now;
+}
+
+bool TTokenBuckets::Take(TBucket& bucket, TClock::time_point now) const noexcept {
+    Refill(bucket, now);
+    if (bucket.Tokens < 1) {
+        return false;
+    }
+    bucket.Tokens -= 1;
+    return true;
+}
+
+void TTokenBuckets::Sweep(TClock::time_point now) {
+    // a bucket takes Burst / Rate to refill, sweeping more often finds nothing new
+    std::chrono::duration<double> refill{Burst / Rate};
+    if (now - LastSweep < refill) {
+        return;
+    }
+    LastSweep = now;
+    for (auto it = Buckets.begin(); it != Buckets.end();) {
+        Refill(it->second, now);
+        if (it->second.Tokens >= Burst) {
+            it = Buckets.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+TCoDel::TCoDel(std::chrono::microseconds target, std::chrono::milliseconds interval) noexcept
+    : Target{target}
+    , Interval{interval}
+    , FirstAbove{}
+    , DropNext{}
+    , Count{0}
+    , Dropping{false}
+{}
+
+bool TCoDel::ShouldShed(TClock::duration sojourn, TClock::time_point now) noexcept {
+    if (Target == TClock::duration::zero() || sojourn < Target) {
+        FirstAbove = {};
+        Dropping = false;
+        return false;
+    }
+    if (FirstAbove == TClock::time_point{}) {
+        FirstAbove = now + Interval;
+        return false;
+    }
+    if (!Dropping) {
+        if (now < FirstAbove) {
+            return false;
+        }
+        Dropping = true;
+        // a new episode soon after the last one resumes near its drop rate
+        Count = Count > 2 && now - DropNext < 16 * Interval ? Count - 2 : 1;
+        DropNext = ControlLaw(now);
+        return true;
+    }
+    if (now < DropNext) {
+        return false;
+    }
+    ++Count;
+    DropNext = ControlLaw(DropNext);
+    return true;
+}
+
+TCoDel::TClock::time_point TCoDel::ControlLaw(TClock::time_point from) const noexcept {
+    auto step = std::chrono::duration_cast<TClock::duration>(Interval / std::sqrt(static_cast<double>(Count)));
+    return from + step;
+}
+
+TReactorShedder::TReactorShedder(std::chrono::microseconds target, std::chrono::milliseconds interval) noexcept
+    : Enabled{target > std::chrono::microseconds::zero()}
+    , Target{target}
+    , Controller{target, interval}
+    , WaitStart{}
+    , LastReturn{TClock::now()}
+    , ReadySince{LastReturn}
+{}
+
+void TReactorShedder::BeforeWait() noexcept {
+    if (Enabled) {
+        WaitStart = TClock::now();
+    }
+}
+
+void TReactorShedder::AfterWait() noexcept {
+    if (Enabled) {
+        auto now = TClock::now();
+        ReadySince = now - WaitStart < Target ? LastReturn : now;
+        LastReturn = now;
+    }
+}
+
+bool TReactorShedder::ShouldShed() noexcept {
+    if (!Enabled) {
+        return false;
+    }
+    auto now = TClock::now();
+    return Controller.ShouldShed(now - ReadySince, now);
+}
+
+TAdmission::TAdmission(TAdmissionConfig config)
+    : Config{config}
+    , Buckets{config.Rate, config.Burst, config.MaxPeers}
+    , Limited{0}
+    , ShedCount{0}
+{}
+
+bool TAdmission::Admit(const TSocketAddress& peer) {
+    if (Buckets.TryAcquire(peer, TTokenBuckets::TClock::now())) {
+        return true;
+    }
+    Limited.fetch_add(1, std::memory_order_relaxed);
+    return false;
+}
+
+TReactorShedder TAdmission::MakeShedder() const noexcept {
+    return TReactorShedder{Config.Target, Config.Interval};
+}
+
+void TAdmission::Shed() noexcept {
+    ShedCount.fetch_add(1, std::memory_order_relaxed);
+}
+
+TAdmissionStats TAdmission::GetStats() const noexcept {
+    return TAdmissionStats{
+        Limited.load(std::memory_order_relaxed),
+        ShedCount.load(std::memory_order_relaxed)};
+}
@@ -0,0 +1,152 @@
+#pragma once
+
+#include <posix/net/socket.h>
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
+
+struct TAdmissionConfig {
+    // connections a peer may open per second, 0 disables the limit.
+    // Peers are told apart by host, unix peers aren't limited
+    double Rate = 0;
+    // connections a peer may open at once after being idle
+    double Burst = 1;
+    // past this many peers new ones share a single bucket, so a flood of
+    // addresses is limited as a whole instead of getting through unchecked
+    std::size_t MaxPeers = 65536;
+    // CoDel: once work has waited longer than Target for a whole Interval,
+    // it's shed at a rate growing until the wait drops back, 0 disables it
+    std::chrono::microseconds Target{0};
+    std::chrono::milliseconds Interval{100};
+};
+
+struct TAdmissionStats {
+    std::uint64_t Limited = 0;
+    std::uint64_t Shed = 0;
+};
+
+// Per-peer token buckets, safe to use from several threads
+class TTokenBuckets {
+public:
+    using TClock = std::chrono::steady_clock;
+
+public:
+    TTokenBuckets(double rate, double burst, std::size_t maxPeers);
+
+    [[nodiscard]]
+    bool TryAcquire(const TSocketAddress& peer, TClock::time_point now);
+
+private:
+    // the address type followed by the host bytes
+    using TKey = std::array<std::byte, 17>;
+
+    struct THash {
+        std::size_t operator()(const TKey& key) const noexcept;
+    };
+
+    struct TBucket {
+        double Tokens;
+        TClock::time_point Updated;
+    };
+
+private:
+    void Refill(TBucket& bucket, TClock::time_point now) const noexcept;
+
+    // drops the buckets that have refilled, they behave as new ones anyway
+    void Sweep(TClock::time_point now);
+
+    [[nodiscard]]
+    bool Take(TBucket& bucket, TClock::time_point now) const noexcept;
+
+private:
+    double Rate;
+    double Burst;
+    std::size_t MaxPeers;
+    std::mutex Mutex;
+    std::unordered_map<TKey, TBucket, THash> Buckets;
+    // taken from by peers that found no room for their own bucket
+    TBucket Overflow;
+    TClock::time_point LastSweep;
+};
+
+// The CoDel control law over the time work waits to be served. It isn't
+// thread safe, every queue has its own
+class TCoDel {
+public:
+    using TClock = std::chrono::steady_clock;
+
+public:
+    TCoDel(std::chrono::microseconds target, std::chrono::milliseconds interval) noexcept;
+
+    // called when work that has waited for sojourn is about to be served
+    [[nodiscard]]
+    bool ShouldShed(TClock::duration sojourn, TClock::time_point now) noexcept;
+
+private:
+    [[nodiscard]]
+    TClock::time_point ControlLaw(TClock::time_point from) const noexcept;
+
+private:
+    TClock::duration Target;
+    TClock::duration Interval;
+    TClock::time_point FirstAbove;
+    TClock::time_point DropNext;
+    std::size_t Count;
+    bool Dropping;
+};
+
+// CoDel over the ready events of a reactor. Events returned without the
+// reactor waiting at least Target for them are taken as ready since the
+// previous batch was returned, otherwise as ready since this one was
+class TReactorShedder {
+public:
+    using TClock = std::chrono::steady_clock;
+
+public:
+    TReactorShedder(std::chrono::microseconds target, std::chrono::milliseconds interval) noexcept;
+
+    void BeforeWait() noexcept;
+
+    void AfterWait() noexcept;
+
+    // called before serving every event of the batch
+    [[nodiscard]]
+    bool ShouldShed() noexcept;
+
+private:
+    bool Enabled;
+    TClock::duration Target;
+    TCoDel Controller;
+    TClock::time_point WaitStart;
+    TClock::time_point LastReturn;
+    TClock::time_point ReadySince;
+};
+
+// Admission control in front of a server: a rate limit on new connections
+// per peer, and CoDel controllers for the queues work waits in
+class TAdmission {
+public:
+    explicit TAdmission(TAdmissionConfig config);
+
+    [[nodiscard]]
+    bool Admit(const TSocketAddress& peer);
+
+    [[nodiscard]]
+    TReactorShedder MakeShedder() const noexcept;
+
+    // counts work a controller has shed
+    void Shed() noexcept;
+
+    [[nodiscard]]
+    TAdmissionStats GetStats() const noexcept;
+
+private:
+    TAdmissionConfig Config;
+    TTokenBuckets Buckets;
+    std::atomic<std::uint64_t> Limited;
+    std::atomic<std::uint64_t> ShedCount;
+};
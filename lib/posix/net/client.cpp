@@ -4,25 +4,55 @@
 #include <netinet/in.h>
 #include <sys/un.h>
 #include <netdb.h>
+#include <arpa/inet.h>
+
+#include <util/exception/exception.h>
 
 #include <cstring>
 
-TConnectedSocket NInternal::ConnectIP(const std::string& address, int port) {
-    TSocket socket{ESocket::IP};
-    auto& sockAddr = socket.Address<sockaddr_in>();
-    sockAddr.sin_family = AF_INET;
-    sockAddr.sin_port = htons(port);
-    if (auto host = gethostbyname(address.c_str()); host != nullptr) {
-        std::memcpy(std::addressof(sockAddr.sin_addr), host->h_addr_list[0], sizeof(sockAddr.sin_addr));
+namespace {
+    void BindLocal(TSocket& socket, const std::string& address) {
+        TSocketAddress local{socket.GetType()};
+        int parsed = socket.GetType() == ESocket::IP6
+            ? inet_pton(AF_INET6, address.c_str(), std::addressof(local.Address<sockaddr_in6>().sin6_addr))
+            : inet_pton(AF_INET, address.c_str(), std::addressof(local.Address<sockaddr_in>().sin_addr));
+        if (parsed != 1) {
+            throw TException{"Wrong bind address ", address};
+        }
+        if (bind(socket.Get(), local.Data(), local.GetLength()) < 0) {
+            throw std::system_error{std::error_code{errno, std::system_category()}};
+        }
+    }
+}
+
+// IPv6 literals are connected to as is, anything else is resolved as an IPv4 host
+TConnectedSocket NInternal::ConnectIP(const std::string& address, int port, const TSocketOptions& options) {
+    in6_addr address6{};
+    bool ip6 = inet_pton(AF_INET6, address.c_str(), std::addressof(address6)) == 1;
+    TSocket socket{ip6 ? ESocket::IP6 : ESocket::IP};
+    options.ApplyConnecting(socket, socket.GetType());
+    if (auto& local = options.GetBindAddress()) {
+        BindLocal(socket, *local);
+    }
+    if (ip6) {
+        auto& sockAddr = socket.Address<sockaddr_in6>();
+        sockAddr.sin6_port = htons(port);
+        sockAddr.sin6_addr = address6;
+    } else {
+        auto& sockAddr = socket.Address<sockaddr_in>();
+        sockAddr.sin_port = htons(port);
+        if (auto host = gethostbyname(address.c_str()); host != nullptr) {
+            std::memcpy(std::addressof(sockAddr.sin_addr), host->h_addr_list[0], sizeof(sockAddr.sin_addr));
+        }
     }
 
     return Connect(std::move(socket));
 }
 
-TConnectedSocket NInternal::ConnectUNIX(const std::filesystem::path& socketPath) {
+TConnectedSocket NInternal::ConnectUNIX(const std::filesystem::path& socketPath, const TSocketOptions& options) {
     TSocket socket{ESocket::UNIX};
+    options.ApplyConnecting(socket, ESocket::UNIX);
     auto& sockAddr = socket.Address<sockaddr_un>();
-    sockAddr.sun_family = AF_LOCAL;
     std::strncpy(sockAddr.sun_path, socketPath.c_str(), sizeof(sockAddr.sun_path) - 1);
 
     return Connect(std::move(socket));
@@ -1,38 +1,51 @@
 #pragma once
 
 #include <posix/net/socket.h>
+#include <posix/net/connection_pool.h>
+#include <posix/net/socket_options.h>
 #include <async/stop_token/stop_token.h>
 
 namespace NInternal {
-    TConnectedSocket ConnectIP(const std::string& address, int port);
+    TConnectedSocket ConnectIP(const std::string& address, int port, const TSocketOptions& options = {});
 
-    TConnectedSocket ConnectUNIX(const std::filesystem::path& socketPath);
+    TConnectedSocket ConnectUNIX(const std::filesystem::path& socketPath, const TSocketOptions& options = {});
 }
 
 template <typename TSender>
 class TClient {
 public:
-    TClient(TSender sender, const std::string& address, int port)
-        : Socket{NInternal::ConnectIP(address, port)}
+    TClient(TSender sender, const std::string& address, int port, const TSocketOptions& options = {})
+        : Socket{NInternal::ConnectIP(address, port, options)}
         , Sender(std::move(sender))
     {}
 
-    TClient(TSender sender, const std::filesystem::path& socketPath)
-        : Socket{NInternal::ConnectUNIX(socketPath)}
+    TClient(TSender sender, const std::filesystem::path& socketPath, const TSocketOptions& options = {})
+        : Socket{NInternal::ConnectUNIX(socketPath, options)}
+        , Sender(std::move(sender))
+    {}
+
+    // the connection is leased from the pool and returned to it with the
+    // client, waiting at most timeout for one, see TConnectionPool::Acquire
+    TClient(
+        TSender sender,
+        TConnectionPool& pool,
+        const TEndpoint& endpoint,
+        std::chrono::milliseconds timeout = std::chrono::milliseconds{0})
+        : Socket{pool.Acquire(endpoint, timeout)}
         , Sender(std::move(sender))
     {}
 
     virtual ~TClient() = default;
 
     virtual void operator()() {
-        while (Sender(Socket));
+        while (Sender(*Socket));
     }
 
     virtual void operator()(TStopToken& token) {
-        while (!token && Sender(Socket));
+        while (!token && Sender(*Socket));
     }
 
 private:
-    TConnectedSocket Socket;
+    TConnectionPool::TLease Socket;
     TSender Sender;
 };
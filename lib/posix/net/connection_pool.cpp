@@ -0,0 +1,195 @@
+#include "connection_pool.h"
+
+#include <posix/net/client.h>
+
+#include <util/exception/exception.h>
+
+#include <sys/socket.h>
+
+#include <utility>
+
+TEndpoint::TEndpoint(std::string address, int port, TSocketOptions options)
+    : Type{ESocket::IP}
+    , Address{std::move(address)}
+    , Port{port}
+    , Key{Address + ":" + std::to_string(port)}
+    , Options{std::move(options)}
+{}
+
+TEndpoint::TEndpoint(const std::filesystem::path& socketPath, TSocketOptions options)
+    : Type{ESocket::UNIX}
+    , Address{socketPath.string()}
+    , Port{0}
+    , Key{"unix:" + Address}
+    , Options{std::move(options)}
+{}
+
+TConnectedSocket TEndpoint::Connect() const {
+    if (Type == ESocket::UNIX) {
+        return NInternal::ConnectUNIX(Address, Options);
+    }
+    return NInternal::ConnectIP(Address, Port, Options);
+}
+
+const std::string& TEndpoint::GetKey() const noexcept {
+    return Key;
+}
+
+TConnectionPool::TLease::TLease(TConnectedSocket&& socket)
+    : Pool{nullptr}
+    , State{nullptr}
+    , Socket{std::move(socket)}
+{}
+
+TConnectionPool::TLease::TLease(TConnectionPool* pool, TEndpointState* state, TConnectedSocket&& socket)
+    : Pool{pool}
+    , State{state}
+    , Socket{std::move(socket)}
+{}
+
+TConnectionPool::TLease::TLease(TLease&& other) noexcept
+    : Pool{std::exchange(other.Pool, nullptr)}
+    , State{std::exchange(other.State, nullptr)}
+    , Socket{std::move(other.Socket)}
+{
+    other.Socket.reset();
+}
+
+TConnectionPool::TLease& TConnectionPool::TLease::operator=(TLease&& other) noexcept {
+    if (this != std::addressof(other)) {
+        Release();
+        Pool = std::exchange(other.Pool, nullptr);
+        State = std::exchange(other.State, nullptr);
+        Socket = std::move(other.Socket);
+        other.Socket.reset();
+    }
+    return *this;
+}
+
+TConnectionPool::TLease::~TLease() {
+    Release();
+}
+
+TConnectedSocket& TConnectionPool::TLease::operator*() noexcept {
+    return *Socket;
+}
+
+TConnectedSocket* TConnectionPool::TLease::operator->() noexcept {
+    return std::addressof(*Socket);
+}
+
+void TConnectionPool::TLease::Discard() noexcept {
+    auto socket = std::move(Socket);
+    Socket.reset();
+    // gives back only the endpoint slot
+    Release();
+}
+
+void TConnectionPool::TLease::Release() noexcept {
+    if (Pool != nullptr) {
+        Pool->Return(*State, Socket);
+        Pool = nullptr;
+        State = nullptr;
+    }
+    Socket.reset();
+}
+
+TConnectionPool::TConnectionPool(TConnectionPoolConfig config)
+    : Mutex{}
+    , Config{config}
+    , Endpoints{}
+{}
+
+TConnectionPool::TLease TConnectionPool::Acquire(const TEndpoint& endpoint, std::chrono::milliseconds timeout) {
+    auto deadline = TClock::now() + timeout;
+    std::unique_lock lock{Mutex};
+    auto& state = Endpoints[endpoint.GetKey()];
+    while (true) {
+        if (!state.Idle.empty()) {
+            // the most recently used connection is the least likely to be stale
+            auto idle = std::move(state.Idle.back());
+            state.Idle.pop_back();
+            // it keeps its slot while it's probed and closed without the lock
+            lock.unlock();
+            auto expired = Config.IdleTimeout.count() > 0 && TClock::now() - idle.Since > Config.IdleTimeout;
+            if (!expired && IsAlive(idle.Socket)) {
+                return TLease{this, std::addressof(state), std::move(idle.Socket)};
+            }
+            {
+                auto stale = std::move(idle);
+            }
+            lock.lock();
+            --state.Total;
+            state.Released.notify_one();
+            continue;
+        }
+        if (state.Total < Config.MaxPerEndpoint) {
+            break;
+        }
+        if (timeout.count() == 0) {
+            state.Released.wait(lock);
+        } else if (state.Released.wait_until(lock, deadline) == std::cv_status::timeout && state.Idle.empty()
+            && state.Total >= Config.MaxPerEndpoint)
+        {
+            throw TException{"Timed out waiting for a connection to ", endpoint.GetKey()};
+        }
+    }
+
+    // the slot is reserved so the handshake can run without the lock
+    ++state.Total;
+    lock.unlock();
+    try {
+        return TLease{this, std::addressof(state), endpoint.Connect()};
+    } catch (...) {
+        lock.lock();
+        --state.Total;
+        state.Released.notify_one();
+        throw;
+    }
+}
+
+std::size_t TConnectionPool::Idle() const {
+    std::lock_guard lock{Mutex};
+    std::size_t count = 0;
+    for (auto&& [key, state] : Endpoints) {
+        count += state.Idle.size();
+    }
+    return count;
+}
+
+void TConnectionPool::Return(TEndpointState& state, std::optional<TConnectedSocket>& socket) noexcept {
+    std::optional<TConnectedSocket> closed;
+    bool complete = false;
+    if (socket) {
+        // the request was cut short, it's neither sent nor reused
+        complete = socket->Unflushed() == 0;
+        socket->DiscardOutput();
+        // an idle connection keeps no buffers
+        socket->Trim();
+    }
+    {
+        std::lock_guard lock{Mutex};
+        if (complete && socket->good() && state.Idle.size() < Config.MaxIdle) {
+            try {
+                state.Idle.push_back(TIdle{std::move(*socket), TClock::now()});
+            } catch (...) {
+                --state.Total;
+            }
+        } else {
+            --state.Total;
+        }
+        closed = std::move(socket);
+        socket.reset();
+    }
+    state.Released.notify_one();
+}
+
+bool TConnectionPool::IsAlive(const TConnectedSocket& socket) {
+    if (!socket.good() || socket.rdbuf()->in_avail() > 0) {
+        return false;
+    }
+    // EAGAIN means the peer is still there and has nothing unsolicited to say
+    char byte;
+    auto res = recv(socket.GetId(), std::addressof(byte), 1, MSG_PEEK | MSG_DONTWAIT);
+    return res < 0 && (errno == EAGAIN || errno == EWOULDBLOCK);
+}
@@ -0,0 +1,119 @@
+#pragma once
+
+#include <posix/net/socket.h>
+#include <posix/net/socket_options.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <filesystem>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+class TEndpoint {
+public:
+    TEndpoint(std::string address, int port, TSocketOptions options = {});
+
+    explicit TEndpoint(const std::filesystem::path& socketPath, TSocketOptions options = {});
+
+    [[nodiscard]]
+    TConnectedSocket Connect() const;
+
+    [[nodiscard]]
+    const std::string& GetKey() const noexcept;
+
+private:
+    ESocket Type;
+    std::string Address;
+    int Port;
+    std::string Key;
+    TSocketOptions Options;
+};
+
+struct TConnectionPoolConfig {
+    // idle connections kept per endpoint, extra ones are closed on return
+    std::size_t MaxIdle = 8;
+    // leased and idle connections per endpoint, Acquire blocks above it
+    std::size_t MaxPerEndpoint = 64;
+    // 0 keeps idle connections until they fail the liveness check
+    std::chrono::milliseconds IdleTimeout{0};
+};
+
+// Thread-safe pool of keep-alive connections. An idle connection is reused
+// only if a non-blocking peek finds it open and without unread data
+class TConnectionPool {
+    using TClock = std::chrono::steady_clock;
+
+    struct TIdle {
+        TConnectedSocket Socket;
+        TClock::time_point Since;
+    };
+
+    struct TEndpointState {
+        std::vector<TIdle> Idle;
+        std::size_t Total = 0;
+        // notified when a slot of this endpoint is freed
+        std::condition_variable Released;
+    };
+
+public:
+    // Returns the socket to its pool on destruction unless it was discarded,
+    // its stream has failed or it has unflushed output: the exchange was cut
+    // short, so the connection is closed. A lease built from a socket owns it
+    // unpooled
+    class TLease {
+    public:
+        explicit(false) TLease(TConnectedSocket&& socket);
+
+        TLease(const TLease&) = delete;
+        TLease& operator=(const TLease&) = delete;
+
+        TLease(TLease&& other) noexcept;
+
+        TLease& operator=(TLease&& other) noexcept;
+
+        ~TLease();
+
+        TConnectedSocket& operator*() noexcept;
+
+        TConnectedSocket* operator->() noexcept;
+
+        // the connection is closed instead of being returned, the lease is
+        // empty afterwards
+        void Discard() noexcept;
+
+    private:
+        friend class TConnectionPool;
+
+        TLease(TConnectionPool* pool, TEndpointState* state, TConnectedSocket&& socket);
+
+        void Release() noexcept;
+
+    private:
+        TConnectionPool* Pool;
+        TEndpointState* State;
+        std::optional<TConnectedSocket> Socket;
+    };
+
+public:
+    explicit TConnectionPool(TConnectionPoolConfig config = {});
+
+    // Waits at most timeout for a slot when the endpoint is at
+    // MaxPerEndpoint and throws after it, 0 waits as long as it takes
+    TLease Acquire(const TEndpoint& endpoint, std::chrono::milliseconds timeout = std::chrono::milliseconds{0});
+
+    [[nodiscard]]
+    std::size_t Idle() const;
+
+private:
+    void Return(TEndpointState& state, std::optional<TConnectedSocket>& socket) noexcept;
+
+    static bool IsAlive(const TConnectedSocket& socket);
+
+private:
+    mutable std::mutex Mutex;
+    TConnectionPoolConfig Config;
+    std::unordered_map<std::string, TEndpointState> Endpoints;
+};
@@ -0,0 +1,207 @@
+#include "datagram.h"
+
+#include <util/exception/exception.h>
+
+#include <netinet/in.h>
+#include <netinet/udp.h>
+
+#include <cstring>
+#include <system_error>
+
+namespace {
+    // room for a GRO segment size on receive or a GSO one on send
+    constexpr std::size_t ControlSize = CMSG_SPACE(sizeof(int));
+
+    int AcquireDatagramSocket(ESocket type) {
+        int family;
+        switch (type) {
+            case ESocket::IP:
+                family = AF_INET;
+                break;
+            case ESocket::IP6:
+                family = AF_INET6;
+                break;
+            case ESocket::UNIX:
+                family = AF_LOCAL;
+                break;
+            default:
+                throw TException{"Wrong socket type"};
+        }
+        int fd = socket(family, SOCK_DGRAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+        if (fd < 0) {
+            throw std::system_error{std::error_code{errno, std::system_category()}};
+        }
+        return fd;
+    }
+
+    msghdr& Header(auto& header) {
+#ifdef __linux__
+        return header.msg_hdr;
+#else
+        return header;
+#endif
+    }
+}
+
+TDatagramSocket::TDatagramSocket(ESocket type, TDatagramConfig config)
+    : TUniqueFd{AcquireDatagramSocket(type)}
+    , Address{type}
+    , Config{config}
+    , Buffer{std::make_unique<std::byte[]>(config.Batch * config.BufferSize)}
+    , Received(config.Batch, TDatagram{{}, TSocketAddress{type}, 0, false})
+    , Headers(config.Batch)
+    , Vectors(config.Batch)
+    , Control(config.Batch * ControlSize)
+{
+    if (Config.Batch == 0 || Config.BufferSize == 0) {
+        throw TException{"Datagram batch and buffer must not be empty"};
+    }
+    if (Config.Gro) {
+#if defined(__linux__) && defined(UDP_GRO)
+        int enable = 1;
+        if (setsockopt(Get(), SOL_UDP, UDP_GRO, std::addressof(enable), sizeof(enable)) < 0) {
+            throw std::system_error{std::error_code{errno, std::system_category()}};
+        }
+#else
+        throw TException{"UDP GRO is not supported on this platform"};
+#endif
+    }
+}
+
+void TDatagramSocket::Bind(const TSocketAddress& address) {
+    if (bind(Get(), address.Data(), address.GetLength()) < 0) {
+        throw std::system_error{std::error_code{errno, std::system_category()}};
+    }
+    Address = address;
+    socklen_t length = TSocketAddress::Capacity();
+    if (getsockname(Get(), Address.Data(), std::addressof(length)) < 0) {
+        throw std::system_error{std::error_code{errno, std::system_category()}};
+    }
+    Address.SetLength(length);
+}
+
+std::span<const TDatagram> TDatagramSocket::Receive() {
+    for (std::size_t i = 0; i < Config.Batch; ++i) {
+        Prepare(i);
+        auto& header = Header(Headers[i]);
+        Vectors[i] = iovec{Buffer.get() + i * Config.BufferSize, Config.BufferSize};
+        header.msg_name = Received[i].Peer.Data();
+        header.msg_namelen = TSocketAddress::Capacity();
+    }
+
+#ifdef __linux__
+    int count = recvmmsg(Get(), Headers.data(), static_cast<unsigned>(Config.Batch), 0, nullptr);
+#else
+    int count = 0;
+    while (static_cast<std::size_t>(count) < Config.Batch) {
+        auto res = recvmsg(Get(), std::addressof(Headers[count]), 0);
+        if (res < 0) {
+            break;
+        }
+        Vectors[count].iov_len = static_cast<std::size_t>(res);
+        ++count;
+    }
+    if (count == 0) {
+        count = -1;
+    }
+#endif
+    if (count < 0) {
+        if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
+            return {};
+        }
+        throw std::system_error{std::error_code{errno, std::system_category()}};
+    }
+
+    for (int i = 0; i < count; ++i) {
+        auto& header = Header(Headers[i]);
+        auto& datagram = Received[i];
+#ifdef __linux__
+        auto size = static_cast<std::size_t>(Headers[i].msg_len);
+#else
+        auto size = Vectors[i].iov_len;
+#endif
+        datagram.Data = {static_cast<const std::byte*>(Vectors[i].iov_base), size};
+        datagram.Peer.SetLength(header.msg_namelen);
+        datagram.Segment = 0;
+        datagram.Truncated = (header.msg_flags & MSG_TRUNC) != 0;
+#if defined(__linux__) && defined(UDP_GRO)
+        for (auto cmsg = CMSG_FIRSTHDR(std::addressof(header)); cmsg != nullptr; cmsg = CMSG_NXTHDR(std::addressof(header), cmsg)) {
+            if (cmsg->cmsg_level == SOL_UDP && cmsg->cmsg_type == UDP_GRO) {
+                int segment;
+                std::memcpy(std::addressof(segment), CMSG_DATA(cmsg), sizeof(segment));
+                datagram.Segment = static_cast<std::uint16_t>(segment);
+            }
+        }
+#endif
+    }
+    return std::span{Received}.first(static_cast<std::size_t>(count));
+}
+
+std::size_t TDatagramSocket::Send(std::span<const TDatagram> datagrams) {
+    std::size_t sent = 0;
+    while (sent < datagrams.size()) {
+        auto batch = std::min(datagrams.size() - sent, Config.Batch);
+        for (std::size_t i = 0; i < batch; ++i) {
+            auto& datagram = datagrams[sent + i];
+            Prepare(i);
+            auto& header = Header(Headers[i]);
+            Vectors[i] = iovec{const_cast<std::byte*>(datagram.Data.data()), datagram.Data.size()};
+            header.msg_name = const_cast<sockaddr*>(datagram.Peer.Data());
+            header.msg_namelen = datagram.Peer.GetLength();
+            if (datagram.Segment == 0) {
+                header.msg_control = nullptr;
+                header.msg_controllen = 0;
+                continue;
+            }
+#if defined(__linux__) && defined(UDP_SEGMENT)
+            header.msg_controllen = CMSG_SPACE(sizeof(std::uint16_t));
+            auto cmsg = CMSG_FIRSTHDR(std::addressof(header));
+            cmsg->cmsg_level = SOL_UDP;
+            cmsg->cmsg_type = UDP_SEGMENT;
+            cmsg->cmsg_len = CMSG_LEN(sizeof(std::uint16_t));
+            std::memcpy(CMSG_DATA(cmsg), std::addressof(datagram.Segment), sizeof(std::uint16_t));
+#else
+            throw TException{"UDP GSO is not supported on this platform"};
+#endif
+        }
+
+#ifdef __linux__
+        int count = sendmmsg(Get(), Headers.data(), static_cast<unsigned>(batch), MSG_NOSIGNAL);
+#else
+        int count = 0;
+        while (static_cast<std::size_t>(count) < batch && sendmsg(Get(), std::addressof(Headers[count]), MSG_NOSIGNAL) >= 0) {
+            ++count;
+        }
+        if (count == 0) {
+            count = -1;
+        }
+#endif
+        if (count < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                return sent;
+            }
+            if (errno == EINTR) {
+                continue;
+            }
+            throw std::system_error{std::error_code{errno, std::system_category()}};
+        }
+        sent += static_cast<std::size_t>(count);
+        if (static_cast<std::size_t>(count) < batch) {
+            return sent;
+        }
+    }
+    return sent;
+}
+
+const TSocketAddress& TDatagramSocket::GetAddress() const noexcept {
+    return Address;
+}
+
+void TDatagramSocket::Prepare(std::size_t index) {
+    auto& header = Header(Headers[index]);
+    header = msghdr{};
+    header.msg_iov = std::addressof(Vectors[index]);
+    header.msg_iovlen = 1;
+    header.msg_control = Control.data() + index * ControlSize;
+    header.msg_controllen = ControlSize;
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <posix/file_descriptor/unique_fd.h>
+#include <posix/net/socket.h>
+
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <vector>
+
+struct TDatagram {
+    std::span<const std::byte> Data;
+    TSocketAddress Peer{ESocket::IP};
+    // GRO: size of the datagrams coalesced into Data, 0 if it's a single one.
+    // GSO: Data is sent as datagrams of this size, 0 sends it as is
+    std::uint16_t Segment = 0;
+    // received only: the message didn't fit TDatagramConfig::BufferSize and
+    // Data holds what did, the rest is lost
+    bool Truncated = false;
+};
+
+struct TDatagramConfig {
+    // messages received or sent per syscall
+    std::size_t Batch = 64;
+    // receive buffer of a single message, it has to fit a whole GRO batch
+    std::size_t BufferSize = 2048;
+    // lets the kernel coalesce datagrams of a flow into one message
+    bool Gro = false;
+};
+
+// Non-blocking connectionless socket that receives and sends batches of
+// messages per syscall (recvmmsg/sendmmsg on linux). All buffers are allocated
+// up front. It's an IFd, so readiness is polled with TSocketPool::Watch
+class TDatagramSocket : public TUniqueFd {
+public:
+    explicit TDatagramSocket(ESocket type, TDatagramConfig config = {});
+
+    TDatagramSocket(TDatagramSocket&&) noexcept = default;
+    TDatagramSocket& operator=(TDatagramSocket&&) noexcept = default;
+
+    // port 0 binds to an ephemeral one, the bound address is read back
+    void Bind(const TSocketAddress& address);
+
+    // Returns the messages read by one syscall, empty once there is nothing
+    // to read. They point into internal buffers and stay valid until the next call
+    std::span<const TDatagram> Receive();
+
+    // Returns the number of messages sent, it's less than requested if the
+    // socket buffer is full
+    std::size_t Send(std::span<const TDatagram> datagrams);
+
+    [[nodiscard]]
+    const TSocketAddress& GetAddress() const noexcept;
+
+private:
+    void Prepare(std::size_t index);
+
+private:
+    TSocketAddress Address;
+    TDatagramConfig Config;
+    std::unique_ptr<std::byte[]> Buffer;
+    std::vector<TDatagram> Received;
+#ifdef __linux__
+    std::vector<mmsghdr> Headers;
+#else
+    std::vector<msghdr> Headers;
+#endif
+    std::vector<iovec> Vectors;
+    std::vector<std::byte> Control;
+};
@@ -0,0 +1,293 @@
+#include "event_loop.h"
+
+#include <posix/net/server.h>
+
+#include <sys/socket.h>
+
+#include <system_error>
+
+namespace {
+    // an fd known only by its number, it may be closed already
+    class TFdNumber : public IFd {
+    public:
+        explicit TFdNumber(int fd) noexcept
+            : Fd{fd}
+        {}
+
+        int Get() const override {
+            return Fd;
+        }
+
+    private:
+        int Fd;
+    };
+}
+
+// owns a spawned task: starts eagerly, frees itself on completion and records
+// the exception escaping the task in the loop
+struct TEventLoop::TDetached {
+    struct promise_type {
+        promise_type(TEventLoop& loop, TTask<void>&) noexcept
+            : Loop{loop}
+        {}
+
+        // the frame's locals, e.g. the sockets, are closed by now
+        ~promise_type() {
+            auto task = std::coroutine_handle<promise_type>::from_promise(*this).address();
+            auto node = Loop.Spawned.extract(task);
+            if (!node.empty()) {
+                for (auto fd : node.mapped()) {
+                    Loop.Release(fd, task);
+                }
+            }
+        }
+
+        TDetached get_return_object() {
+            auto task = std::coroutine_handle<promise_type>::from_promise(*this).address();
+            Loop.Spawned.emplace(task, std::vector<int>{});
+            Loop.Current = task;
+            return {};
+        }
+
+        std::suspend_never initial_suspend() const noexcept {
+            return {};
+        }
+
+        std::suspend_never final_suspend() const noexcept {
+            return {};
+        }
+
+        void return_void() const noexcept {}
+
+        void unhandled_exception() noexcept {
+            if (!Loop.Error) {
+                Loop.Error = std::current_exception();
+            }
+        }
+
+        TEventLoop& Loop;
+    };
+};
+
+TEventLoop::TWait::TWait(TEventLoop& loop, const IFd& fd, EPollEvent event) noexcept
+    : Loop{loop}
+    , Fd{fd}
+    , Event{event}
+{}
+
+bool TEventLoop::TWait::await_ready() const noexcept {
+    return false;
+}
+
+void TEventLoop::TWait::await_suspend(std::coroutine_handle<> handle) {
+    Loop.Park(Fd, Event, handle);
+}
+
+void TEventLoop::TWait::await_resume() const noexcept {}
+
+TEventLoop::TSleep::TSleep(TEventLoop& loop, std::chrono::milliseconds delay) noexcept
+    : Loop{loop}
+    , Delay{delay}
+    , Handle{}
+    , Task{nullptr}
+{}
+
+bool TEventLoop::TSleep::await_ready() const noexcept {
+    return false;
+}
+
+void TEventLoop::TSleep::await_suspend(std::coroutine_handle<> handle) {
+    Handle = handle;
+    Task = Loop.Current;
+    Loop.Pool.ArmTimer(Delay, reinterpret_cast<std::uint64_t>(this));
+}
+
+void TEventLoop::TSleep::await_resume() const noexcept {}
+
+TEventLoop::TEventLoop(std::size_t capacity, EPollBackend backend, std::chrono::milliseconds tick)
+    : Pool{capacity, backend}
+    , Tick{tick}
+    , Events(capacity + 1)
+    , Registrations{}
+    , Retired{}
+    , Spawned{}
+    , Current{nullptr}
+    , Error{}
+{}
+
+TEventLoop::~TEventLoop() {
+    while (!Spawned.empty()) {
+        std::coroutine_handle<>::from_address(Spawned.begin()->first).destroy();
+    }
+}
+
+void TEventLoop::Spawn(TTask<void> task) {
+    // a task may spawn another one
+    auto current = Current;
+    Start(*this, std::move(task));
+    Current = current;
+}
+
+void TEventLoop::Run() {
+    TStopToken token;
+    Run(token);
+}
+
+void TEventLoop::Run(TStopToken& token) {
+    while (true) {
+        if (Error) {
+            std::rethrow_exception(std::exchange(Error, nullptr));
+        }
+        if (token || Spawned.empty()) {
+            return;
+        }
+        Retired.clear();
+        auto count = Pool.Get(Events, Tick);
+        for (std::size_t i = 0; i < count; ++i) {
+            auto& event = Events[i];
+            if (event.Event.Timeout()) {
+                auto sleep = reinterpret_cast<TSleep*>(event.Cookie);
+                Resume(sleep->Task, sleep->Handle);
+                continue;
+            }
+            auto& registration = *reinterpret_cast<TRegistration*>(event.Cookie);
+            if (registration.Removed) {
+                continue;
+            }
+            if (!registration.Waiter) {
+                // nobody waits for it and a level-triggered fd would be
+                // reported again on every Get
+                Release(registration.Fd, registration.Task);
+                continue;
+            }
+            Resume(registration.Task, std::exchange(registration.Waiter, nullptr));
+        }
+    }
+}
+
+TEventLoop::TWait TEventLoop::Readable(const IFd& fd) {
+    return TWait{*this, fd, EPollEvent::IN};
+}
+
+TEventLoop::TWait TEventLoop::Writable(const IFd& fd) {
+    return TWait{*this, fd, EPollEvent::OUT};
+}
+
+TEventLoop::TSleep TEventLoop::Sleep(std::chrono::milliseconds delay) {
+    return TSleep{*this, delay};
+}
+
+void TEventLoop::Forget(const IFd& fd) {
+    auto it = Registrations.find(fd.Get());
+    if (it != Registrations.end()) {
+        Release(fd.Get(), it->second.Task);
+    }
+}
+
+TTask<TConnectedSocket> TEventLoop::Accept(const TSocket& listener) {
+    while (true) {
+        if (auto socket = NInternal::TryAccept(listener, true)) {
+            co_return std::move(*socket);
+        }
+        co_await Readable(listener);
+    }
+}
+
+TTask<std::size_t> TEventLoop::ReadSome(TConnectedSocket& socket, std::span<std::byte> data) {
+    // input already buffered by the stream is served first
+    if (socket.rdbuf()->in_avail() > 0) {
+        co_return static_cast<std::size_t>(socket.readsome(reinterpret_cast<char*>(data.data()), data.size()));
+    }
+    while (true) {
+        auto res = socket.GetRecorder().Read(data.size(), [&] {
+            return recv(socket.GetId(), data.data(), data.size(), 0);
+        });
+        if (res >= 0) {
+            co_return static_cast<std::size_t>(res);
+        }
+        if (errno == EINTR) {
+            continue;
+        }
+        if (errno != EAGAIN && errno != EWOULDBLOCK) {
+            throw std::system_error{std::error_code{errno, std::system_category()}};
+        }
+        co_await Readable(socket.GetFd());
+    }
+}
+
+TTask<void> TEventLoop::WriteAll(TConnectedSocket& socket, std::span<const std::byte> data) {
+    while (!data.empty()) {
+        auto res = socket.GetRecorder().Write(data.size(), [&] {
+            return send(socket.GetId(), data.data(), data.size(), MSG_NOSIGNAL);
+        });
+        if (res >= 0) {
+            data = data.subspan(static_cast<std::size_t>(res));
+            continue;
+        }
+        if (errno == EINTR) {
+            continue;
+        }
+        if (errno != EAGAIN && errno != EWOULDBLOCK) {
+            throw std::system_error{std::error_code{errno, std::system_category()}};
+        }
+        co_await Writable(socket.GetFd());
+    }
+}
+
+std::size_t TEventLoop::Active() const noexcept {
+    return Spawned.size();
+}
+
+TSocketPool& TEventLoop::GetPool() noexcept {
+    return Pool;
+}
+
+void TEventLoop::Park(const IFd& fd, EPollEvent event, std::coroutine_handle<> handle) {
+    auto [it, inserted] = Registrations.try_emplace(fd.Get(), TRegistration{fd.Get(), event, handle, Current, false});
+    auto& registration = it->second;
+    if (inserted) {
+        try {
+            Pool.Watch(fd, event, reinterpret_cast<std::uint64_t>(std::addressof(registration)));
+        } catch (...) {
+            Registrations.erase(it);
+            throw;
+        }
+    } else {
+        if (registration.Event != event) {
+            Pool.Set(fd, event);
+            registration.Event = event;
+        }
+        registration.Waiter = handle;
+    }
+    if (inserted || registration.Task != Current) {
+        registration.Task = Current;
+        if (auto task = Spawned.find(Current); task != Spawned.end()) {
+            task->second.push_back(fd.Get());
+        }
+    }
+}
+
+void TEventLoop::Release(int fd, void* task) noexcept {
+    auto it = Registrations.find(fd);
+    if (it == Registrations.end() || it->second.Task != task) {
+        return;
+    }
+    try {
+        Pool.Unwatch(TFdNumber{fd});
+    } catch (...) {
+        // the pool has dropped the fd anyway
+    }
+    auto node = Registrations.extract(it);
+    node.mapped().Removed = true;
+    Retired.push_back(std::move(node));
+}
+
+void TEventLoop::Resume(void* task, std::coroutine_handle<> handle) {
+    Current = task;
+    handle.resume();
+    Current = nullptr;
+}
+
+TEventLoop::TDetached TEventLoop::Start([[maybe_unused]] TEventLoop& loop, TTask<void> task) {
+    co_await task;
+}
@@ -0,0 +1,140 @@
+#pragma once
+
+#include <posix/net/socket.h>
+#include <posix/net/socket_pool.h>
+#include <async/coroutine/task.h>
+#include <async/stop_token/stop_token.h>
+
+#include <chrono>
+#include <coroutine>
+#include <exception>
+#include <span>
+#include <unordered_map>
+#include <vector>
+
+// Single-threaded scheduler for TTask coroutines. A coroutine waiting for an fd
+// or a timer is parked in the pool and is resumed from Run once the pool
+// reports it. Sockets must be non-blocking.
+// An fd stays registered with the pool from its first wait until the spawned
+// task that waited on it finishes, so a wait costs no syscall unless it
+// changes the direction. A task that closes such an fd and goes on must
+// Forget it first, as its number may be reused
+class TEventLoop {
+public:
+    class TWait {
+    public:
+        TWait(TEventLoop& loop, const IFd& fd, EPollEvent event) noexcept;
+
+        bool await_ready() const noexcept;
+
+        void await_suspend(std::coroutine_handle<> handle);
+
+        void await_resume() const noexcept;
+
+    private:
+        TEventLoop& Loop;
+        const IFd& Fd;
+        EPollEvent Event;
+    };
+
+    class TSleep {
+    public:
+        TSleep(TEventLoop& loop, std::chrono::milliseconds delay) noexcept;
+
+        bool await_ready() const noexcept;
+
+        void await_suspend(std::coroutine_handle<> handle);
+
+        void await_resume() const noexcept;
+
+    private:
+        friend class TEventLoop;
+
+        TEventLoop& Loop;
+        std::chrono::milliseconds Delay;
+        // the timer cookie points to the awaiter, it lives in the frame
+        std::coroutine_handle<> Handle;
+        void* Task;
+    };
+
+public:
+    explicit TEventLoop(
+        std::size_t capacity,
+        EPollBackend backend = EPollBackend::Epoll,
+        std::chrono::milliseconds tick = std::chrono::milliseconds{100});
+
+    TEventLoop(const TEventLoop&) = delete;
+    TEventLoop& operator=(const TEventLoop&) = delete;
+
+    // destroys the frames of tasks that are still suspended
+    ~TEventLoop();
+
+    // runs the task up to its first suspension point
+    void Spawn(TTask<void> task);
+
+    // returns once all spawned tasks have finished, rethrows the first
+    // exception that escaped a spawned task
+    void Run();
+
+    void Run(TStopToken& token);
+
+    TWait Readable(const IFd& fd);
+
+    TWait Writable(const IFd& fd);
+
+    TSleep Sleep(std::chrono::milliseconds delay);
+
+    // stops polling an fd, no task may be waiting on it
+    void Forget(const IFd& fd);
+
+    // the accepted socket is switched to non-blocking mode
+    TTask<TConnectedSocket> Accept(const TSocket& listener);
+
+    // returns 0 once the peer has closed the connection
+    TTask<std::size_t> ReadSome(TConnectedSocket& socket, std::span<std::byte> data);
+
+    TTask<void> WriteAll(TConnectedSocket& socket, std::span<const std::byte> data);
+
+    [[nodiscard]]
+    std::size_t Active() const noexcept;
+
+    [[nodiscard]]
+    TSocketPool& GetPool() noexcept;
+
+private:
+    struct TDetached;
+
+    // the pool cookie of an fd, it outlives the waits on it
+    struct TRegistration {
+        int Fd;
+        EPollEvent Event;
+        std::coroutine_handle<> Waiter;
+        // the spawned task that waited on the fd last
+        void* Task;
+        bool Removed;
+    };
+
+    using TRegistrations = std::unordered_map<int, TRegistration>;
+
+private:
+    static TDetached Start(TEventLoop& loop, TTask<void> task);
+
+    void Park(const IFd& fd, EPollEvent event, std::coroutine_handle<> handle);
+
+    // unless the fd has been waited on by another task since
+    void Release(int fd, void* task) noexcept;
+
+    void Resume(void* task, std::coroutine_handle<> handle);
+
+private:
+    TSocketPool Pool;
+    std::chrono::milliseconds Tick;
+    std::vector<TSocketPool::TReadyEvent> Events;
+    TRegistrations Registrations;
+    // released registrations may still be reported by the last Get
+    std::vector<TRegistrations::node_type> Retired;
+    // the fds every spawned task has waited on
+    std::unordered_map<void*, std::vector<int>> Spawned;
+    void* Current;
+    std::exception_ptr Error;
+};
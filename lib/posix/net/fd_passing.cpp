@@ -0,0 +1,81 @@
+#include "fd_passing.h"
+
+#include <util/exception/exception.h>
+
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+#include <cstring>
+#include <system_error>
+#include <vector>
+
+void NInternal::SendFds(const IFd& channel, std::span<const int> fds, std::span<const std::byte> payload) {
+    if (payload.empty()) {
+        throw TException{"Fds must be sent with a payload"};
+    }
+    iovec vector{const_cast<std::byte*>(payload.data()), payload.size()};
+    std::vector<std::byte> control(CMSG_SPACE(fds.size_bytes()));
+
+    msghdr header{};
+    header.msg_iov = std::addressof(vector);
+    header.msg_iovlen = 1;
+    if (!fds.empty()) {
+        header.msg_control = control.data();
+        header.msg_controllen = control.size();
+        auto cmsg = CMSG_FIRSTHDR(std::addressof(header));
+        cmsg->cmsg_level = SOL_SOCKET;
+        cmsg->cmsg_type = SCM_RIGHTS;
+        cmsg->cmsg_len = CMSG_LEN(fds.size_bytes());
+        std::memcpy(CMSG_DATA(cmsg), fds.data(), fds.size_bytes());
+    }
+
+    while (sendmsg(channel.Get(), std::addressof(header), MSG_NOSIGNAL) < 0) {
+        if (errno != EINTR) {
+            throw std::system_error{std::error_code{errno, std::system_category()}};
+        }
+    }
+}
+
+std::optional<std::pair<std::size_t, std::size_t>> NInternal::ReceiveFds(
+    const IFd& channel, std::span<TUniqueFd> fds, std::span<std::byte> payload)
+{
+    iovec vector{payload.data(), payload.size()};
+    std::vector<std::byte> control(CMSG_SPACE(fds.size() * sizeof(int)));
+
+    msghdr header{};
+    header.msg_iov = std::addressof(vector);
+    header.msg_iovlen = 1;
+    header.msg_control = control.data();
+    header.msg_controllen = control.size();
+
+    int flags = 0;
+#ifdef MSG_CMSG_CLOEXEC
+    flags |= MSG_CMSG_CLOEXEC;
+#endif
+    ssize_t size;
+    while ((size = recvmsg(channel.Get(), std::addressof(header), flags)) < 0) {
+        if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            return std::nullopt;
+        }
+        if (errno != EINTR) {
+            throw std::system_error{std::error_code{errno, std::system_category()}};
+        }
+    }
+
+    std::size_t count = 0;
+    for (auto cmsg = CMSG_FIRSTHDR(std::addressof(header)); cmsg != nullptr; cmsg = CMSG_NXTHDR(std::addressof(header), cmsg)) {
+        if (cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS) {
+            continue;
+        }
+        auto received = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+        for (std::size_t i = 0; i < received; ++i) {
+            int fd;
+            std::memcpy(std::addressof(fd), CMSG_DATA(cmsg) + i * sizeof(int), sizeof(fd));
+            fds[count++].Reset(fd);
+        }
+    }
+    if (header.msg_flags & MSG_CTRUNC) {
+        throw TException{"More fds were sent than can be received"};
+    }
+    return std::pair{static_cast<std::size_t>(size), count};
+}
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <posix/file_descriptor/unique_fd.h>
+
+#include <cstddef>
+#include <optional>
+#include <span>
+#include <utility>
+
+namespace NInternal {
+    // Sends fds over a unix socket with SCM_RIGHTS, the payload goes with them
+    // and must not be empty
+    void SendFds(const IFd& channel, std::span<const int> fds, std::span<const std::byte> payload);
+
+    // Returns the payload size and the number of fds received, the fds are
+    // close-on-exec. nullopt is returned if a non-blocking channel is empty,
+    // a payload of 0 bytes means the peer has closed the channel
+    std::optional<std::pair<std::size_t, std::size_t>> ReceiveFds(
+        const IFd& channel, std::span<TUniqueFd> fds, std::span<std::byte> payload);
+}
@@ -0,0 +1,367 @@
+#include "poller.h"
+
+#include <posix/file_descriptor/unique_fd.h>
+#include <posix/file_descriptor/io_uring.h>
+
+#include <util/exception/exception.h>
+
+#include <sys/poll.h>
+#ifdef __linux__
+#include <sys/epoll.h>
+#endif
+
+#include <bit>
+#include <mutex>
+#include <system_error>
+#include <unordered_map>
+#include <vector>
+
+short NInternal::ConvertEvent(EPollEvent event) {
+    switch (event) {
+        case EPollEvent::IN:
+            return POLLIN;
+        case EPollEvent::OUT:
+            return POLLOUT;
+        case EPollEvent::ERR:
+            return POLLERR;
+        case EPollEvent::HUP:
+            return POLLHUP;
+        default:
+            return 0;
+    }
+}
+
+namespace {
+    class TPollPoller : public IPoller {
+    public:
+        explicit TPollPoller(std::size_t capacity) {
+            Registered.reserve(capacity + 1);
+            Data.reserve(capacity + 1);
+            Index.reserve(capacity + 1);
+        }
+
+        void Add(int fd, EPollEvent event, std::uint64_t data) override {
+            std::lock_guard lock{Mutex};
+            if (!Index.emplace(fd, Registered.size()).second) {
+                throw TException{"Fd ", fd, " is already registered in poller"};
+            }
+            Registered.push_back(pollfd{fd, NInternal::ConvertEvent(event), 0});
+            Data.push_back(data);
+        }
+
+        void Set(int fd, EPollEvent event, std::uint64_t data) override {
+            std::lock_guard lock{Mutex};
+            auto pos = Index.at(fd);
+            Registered[pos].events = NInternal::ConvertEvent(event);
+            Data[pos] = data;
+        }
+
+        void Remove(int fd) override {
+            std::lock_guard lock{Mutex};
+            auto it = Index.find(fd);
+            if (it == Index.end()) {
+                return;
+            }
+            auto pos = it->second;
+            Index.erase(it);
+            if (pos + 1 != Registered.size()) {
+                Registered[pos] = Registered.back();
+                Data[pos] = Data.back();
+                Index[Registered[pos].fd] = pos;
+            }
+            Registered.pop_back();
+            Data.pop_back();
+        }
+
+        std::size_t Wait(std::span<TReady> ready, std::chrono::milliseconds timeout) override {
+            {
+                std::lock_guard lock{Mutex};
+                Snapshot = Registered;
+                SnapshotData = Data;
+            }
+
+            int res = poll(Snapshot.data(), Snapshot.size(), timeout.count());
+            if (res < 0) {
+                if (errno == EINTR) {
+                    return 0;
+                }
+                throw std::system_error{std::error_code{errno, std::system_category()}};
+            }
+
+            std::size_t count = 0;
+            for (std::size_t i = 0; i < Snapshot.size() && count < ready.size() && res > 0; ++i) {
+                if (Snapshot[i].revents != 0) {
+                    ready[count++] = TReady{SnapshotData[i], Snapshot[i].revents};
+                    --res;
+                }
+            }
+            return count;
+        }
+
+        [[nodiscard]]
+        bool NeedsWakeup() const noexcept override {
+            return true;
+        }
+
+        [[nodiscard]]
+        EPollBackend GetBackend() const noexcept override {
+            return EPollBackend::Poll;
+        }
+
+    private:
+        std::mutex Mutex;
+        std::vector<pollfd> Registered;
+        std::vector<std::uint64_t> Data;
+        std::unordered_map<int, std::size_t> Index;
+        std::vector<pollfd> Snapshot;
+        std::vector<std::uint64_t> SnapshotData;
+    };
+
+#ifdef __linux__
+    class TEpollPoller : public IPoller {
+    public:
+        TEpollPoller(EPollTrigger trigger, std::size_t capacity)
+            : Fd{epoll_create1(EPOLL_CLOEXEC)}
+            , Trigger{trigger}
+            , Events(capacity + 1)
+        {
+            if (!Fd) {
+                throw std::system_error{std::error_code{errno, std::system_category()}};
+            }
+        }
+
+        void Add(int fd, EPollEvent event, std::uint64_t data) override {
+            Control(EPOLL_CTL_ADD, fd, event, data);
+        }
+
+        void Set(int fd, EPollEvent event, std::uint64_t data) override {
+            Control(EPOLL_CTL_MOD, fd, event, data);
+        }
+
+        void Remove(int fd) override {
+            if (epoll_ctl(Fd.Get(), EPOLL_CTL_DEL, fd, nullptr) < 0 && errno != ENOENT && errno != EBADF) {
+                throw std::system_error{std::error_code{errno, std::system_category()}};
+            }
+        }
+
+        std::size_t Wait(std::span<TReady> ready, std::chrono::milliseconds timeout) override {
+            auto size = std::min(ready.size(), Events.size());
+            int res = epoll_wait(Fd.Get(), Events.data(), static_cast<int>(size), timeout.count());
+            if (res < 0) {
+                if (errno == EINTR) {
+                    return 0;
+                }
+                throw std::system_error{std::error_code{errno, std::system_category()}};
+            }
+
+            for (int i = 0; i < res; ++i) {
+                ready[i] = TReady{Events[i].data.u64, ConvertBack(Events[i].events)};
+            }
+            return res;
+        }
+
+        [[nodiscard]]
+        bool NeedsWakeup() const noexcept override {
+            return false;
+        }
+
+        [[nodiscard]]
+        EPollBackend GetBackend() const noexcept override {
+            return EPollBackend::Epoll;
+        }
+
+    private:
+        void Control(int op, int fd, EPollEvent event, std::uint64_t data) {
+            epoll_event ev{};
+            ev.events = Convert(event);
+            if (Trigger == EPollTrigger::Edge) {
+                ev.events |= EPOLLET;
+            }
+            ev.data.u64 = data;
+            if (epoll_ctl(Fd.Get(), op, fd, std::addressof(ev)) < 0) {
+                throw std::system_error{std::error_code{errno, std::system_category()}};
+            }
+        }
+
+        static std::uint32_t Convert(EPollEvent event) {
+            switch (event) {
+                case EPollEvent::IN:
+                    return EPOLLIN;
+                case EPollEvent::OUT:
+                    return EPOLLOUT;
+                case EPollEvent::ERR:
+                    return EPOLLERR;
+                case EPollEvent::HUP:
+                    return EPOLLHUP;
+                default:
+                    return 0;
+            }
+        }
+
+        static short ConvertBack(std::uint32_t events) {
+            short res = 0;
+            if (events & EPOLLIN) {
+                res |= POLLIN;
+            }
+            if (events & EPOLLOUT) {
+                res |= POLLOUT;
+            }
+            if (events & EPOLLERR) {
+                res |= POLLERR;
+            }
+            if (events & EPOLLHUP) {
+                res |= POLLHUP;
+            }
+            return res;
+        }
+
+    private:
+        TUniqueFd Fd;
+        EPollTrigger Trigger;
+        std::vector<epoll_event> Events;
+    };
+
+    // Level-triggered registrations are one-shot polls re-armed in batch on
+    // the next Wait, edge-triggered ones are multishot polls
+    class TIoUringPoller : public IPoller {
+        static constexpr std::uint64_t IgnoredData = ~std::uint64_t{0};
+        static constexpr std::size_t MaxEntries = 4096;
+
+        struct TRegistration {
+            std::uint64_t Data;
+            short Events;
+            std::uint32_t Generation;
+        };
+
+    public:
+        TIoUringPoller(EPollTrigger trigger, std::size_t capacity)
+            : Ring{static_cast<unsigned>(std::bit_ceil(std::min(capacity + 1, MaxEntries)))}
+            , Trigger{trigger}
+            , Generation{0}
+            , Completions(capacity + 1)
+        {
+            Registrations.reserve(capacity + 1);
+        }
+
+        void Add(int fd, EPollEvent event, std::uint64_t data) override {
+            std::lock_guard lock{Mutex};
+            auto [it, inserted] = Registrations.emplace(
+                fd, TRegistration{data, NInternal::ConvertEvent(event), ++Generation});
+            if (!inserted) {
+                throw TException{"Fd ", fd, " is already registered in poller"};
+            }
+            Arm(fd, it->second);
+            Ring.Submit();
+        }
+
+        void Set(int fd, EPollEvent event, std::uint64_t data) override {
+            std::lock_guard lock{Mutex};
+            auto& registration = Registrations.at(fd);
+            Ring.PreparePollRemove(UserData(fd, registration.Generation), IgnoredData);
+            registration = TRegistration{data, NInternal::ConvertEvent(event), ++Generation};
+            Arm(fd, registration);
+            Ring.Submit();
+        }
+
+        void Remove(int fd) override {
+            std::lock_guard lock{Mutex};
+            auto it = Registrations.find(fd);
+            if (it == Registrations.end()) {
+                return;
+            }
+            Ring.PreparePollRemove(UserData(fd, it->second.Generation), IgnoredData);
+            Registrations.erase(it);
+            Ring.Submit();
+        }
+
+        std::size_t Wait(std::span<TReady> ready, std::chrono::milliseconds timeout) override {
+            {
+                std::lock_guard lock{Mutex};
+                Ring.Submit();
+            }
+            Ring.Wait(timeout);
+
+            std::lock_guard lock{Mutex};
+            auto reaped = Ring.Reap(std::span{Completions}.first(std::min(ready.size(), Completions.size())));
+            std::size_t count = 0;
+            for (std::size_t i = 0; i < reaped; ++i) {
+                auto& completion = Completions[i];
+                if (completion.UserData == IgnoredData) {
+                    continue;
+                }
+                auto fd = static_cast<int>(completion.UserData & 0xffffffff);
+                auto it = Registrations.find(fd);
+                if (it == Registrations.end() || UserData(fd, it->second.Generation) != completion.UserData) {
+                    continue;
+                }
+                if (Trigger == EPollTrigger::Level || !completion.More()) {
+                    Arm(fd, it->second);
+                }
+                if (completion.Result > 0) {
+                    ready[count++] = TReady{it->second.Data, static_cast<short>(completion.Result)};
+                }
+            }
+            return count;
+        }
+
+        [[nodiscard]]
+        bool NeedsWakeup() const noexcept override {
+            return false;
+        }
+
+        [[nodiscard]]
+        EPollBackend GetBackend() const noexcept override {
+            return EPollBackend::IoUring;
+        }
+
+    private:
+        static std::uint64_t UserData(int fd, std::uint32_t generation) {
+            return (std::uint64_t{generation} << 32) | static_cast<std::uint32_t>(fd);
+        }
+
+        void Arm(int fd, const TRegistration& registration) {
+            auto events = static_cast<unsigned>(static_cast<unsigned short>(registration.Events));
+            auto multishot = Trigger == EPollTrigger::Edge;
+            Ring.PreparePoll(fd, events, multishot, UserData(fd, registration.Generation));
+        }
+
+    private:
+        std::mutex Mutex;
+        TIoUring Ring;
+        EPollTrigger Trigger;
+        std::uint32_t Generation;
+        std::unordered_map<int, TRegistration> Registrations;
+        std::vector<TIoUring::TCompletion> Completions;
+    };
+#endif
+}
+
+std::unique_ptr<IPoller> NInternal::MakePoller(EPollBackend backend, EPollTrigger trigger, std::size_t capacity) {
+    switch (backend) {
+        case EPollBackend::IoUring:
+#ifdef __linux__
+            if (TIoUring::Supported()) {
+                return std::make_unique<TIoUringPoller>(trigger, capacity);
+            }
+#endif
+            [[fallthrough]];
+        case EPollBackend::Epoll:
+#ifdef __linux__
+            try {
+                return std::make_unique<TEpollPoller>(trigger, capacity);
+            } catch (const std::system_error& error) {
+                if (error.code().value() != ENOSYS || trigger == EPollTrigger::Edge) {
+                    throw;
+                }
+            }
+#endif
+            [[fallthrough]];
+        case EPollBackend::Poll:
+            if (trigger == EPollTrigger::Edge) {
+                throw TException{"Edge-triggered mode is not supported by poll backend"};
+            }
+            return std::make_unique<TPollPoller>(capacity);
+        default:
+            throw TException{"Unknown poll backend"};
+    }
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <span>
+
+enum class EPollEvent : unsigned char {
+    IN,
+    OUT,
+    HUP,
+    ERR
+};
+
+enum class EPollBackend : unsigned char {
+    Poll,
+    Epoll,
+    IoUring
+};
+
+enum class EPollTrigger : unsigned char {
+    Level,
+    Edge
+};
+
+class IPoller {
+public:
+    struct TReady {
+        std::uint64_t Data;
+        short Events;
+    };
+
+public:
+    virtual ~IPoller() = default;
+
+    virtual void Add(int fd, EPollEvent event, std::uint64_t data) = 0;
+
+    virtual void Set(int fd, EPollEvent event, std::uint64_t data) = 0;
+
+    virtual void Remove(int fd) = 0;
+
+    virtual std::size_t Wait(std::span<TReady> ready, std::chrono::milliseconds timeout) = 0;
+
+    // poll() works on a snapshot of the interest set, so changes made while
+    // it is blocked are only picked up after a wakeup
+    [[nodiscard]]
+    virtual bool NeedsWakeup() const noexcept = 0;
+
+    [[nodiscard]]
+    virtual EPollBackend GetBackend() const noexcept = 0;
+};
+
+namespace NInternal {
+    short ConvertEvent(EPollEvent event);
+
+    std::unique_ptr<IPoller> MakePoller(EPollBackend backend, EPollTrigger trigger, std::size_t capacity);
+}
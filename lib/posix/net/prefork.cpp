@@ -0,0 +1,207 @@
+#include "prefork.h"
+
+#include <posix/file_descriptor/syscalls.h>
+
+#include <util/exception/exception.h>
+
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/prctl.h>
+#endif
+
+#include <csignal>
+#include <limits>
+#include <system_error>
+
+NInternal::TPreforkSupervisor::TPreforkSupervisor(TSocket&& listener, TPreforkConfig config)
+    : Listener{std::move(listener)}
+    , Config{std::move(config)}
+    , Loads{nullptr}
+    , Workers{}
+{
+    if (Config.Workers == 0) {
+        throw TException{"Prefork server needs at least one worker"};
+    }
+    auto size = Config.Workers * sizeof(std::atomic<std::size_t>);
+    auto memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (memory == MAP_FAILED) {
+        throw std::system_error{std::error_code{errno, std::system_category()}};
+    }
+    Loads = static_cast<std::atomic<std::size_t>*>(memory);
+    for (std::size_t i = 0; i < Config.Workers; ++i) {
+        new (Loads + i) std::atomic<std::size_t>{0};
+    }
+    Workers.reserve(Config.Workers);
+}
+
+NInternal::TPreforkSupervisor::~TPreforkSupervisor() {
+    Stop();
+    munmap(Loads, Config.Workers * sizeof(std::atomic<std::size_t>));
+    if (Listener.GetType() == ESocket::UNIX) {
+        try {
+            ReleaseUnixAddress(Listener);
+        } catch (...) {
+            // destructor must be noexcept
+        }
+    }
+}
+
+void NInternal::TPreforkSupervisor::Supervise(TStopToken& token) {
+    if (Workers.empty()) {
+        for (std::size_t i = 0; i < Config.Workers; ++i) {
+            Workers.push_back(TWorker{-1, TUniqueFd{}});
+            Start(i);
+        }
+    }
+
+    TSocketPool pool{1};
+    if (Config.Mode == EPreforkMode::Handoff) {
+        SetNonBlocking(Listener);
+        pool.Watch(Listener, EPollEvent::IN, 0);
+    }
+    std::vector<TSocketPool::TReadyEvent> events(1);
+    while (!token) {
+        auto count = pool.Get(events, Config.Tick);
+        Reap();
+        if (count == 0 || Config.Mode != EPreforkMode::Handoff) {
+            continue;
+        }
+        while (auto accepted = TryAcceptFd(Listener)) {
+            auto& [fd, peer] = *accepted;
+            Config.Server.Options.ApplyAccepted(fd, peer.GetType());
+            Dispatch(fd, peer);
+        }
+    }
+}
+
+const TSocket& NInternal::TPreforkSupervisor::GetSocket() const noexcept {
+    return Listener;
+}
+
+std::vector<int> NInternal::TPreforkSupervisor::GetWorkers() const {
+    std::vector<int> pids;
+    pids.reserve(Workers.size());
+    for (auto&& worker : Workers) {
+        pids.push_back(worker.Pid);
+    }
+    return pids;
+}
+
+std::size_t NInternal::TPreforkSupervisor::GetLoad(std::size_t worker) const noexcept {
+    return Loads[worker].load(std::memory_order_relaxed);
+}
+
+void NInternal::TPreforkSupervisor::Start(std::size_t index) {
+    int fds[2];
+    if (socketpair(AF_LOCAL, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, fds) < 0) {
+        throw std::system_error{std::error_code{errno, std::system_category()}};
+    }
+    TUniqueFd channel{fds[0]};
+    TUniqueFd workerChannel{fds[1]};
+    // a stuck worker makes a send fail instead of blocking the supervisor
+    SetNonBlocking(channel);
+
+    Loads[index].store(0, std::memory_order_relaxed);
+    int pid = fork();
+    if (pid < 0) {
+        throw std::system_error{std::error_code{errno, std::system_category()}};
+    }
+    if (pid == 0) {
+        channel.Reset();
+        RunChild(index, std::move(workerChannel));
+    }
+    Workers[index] = TWorker{pid, std::move(channel)};
+}
+
+void NInternal::TPreforkSupervisor::RunChild(std::size_t index, TUniqueFd&& channel) noexcept {
+    int code = 0;
+    try {
+#ifdef __linux__
+        prctl(PR_SET_PDEATHSIG, SIGTERM);
+#endif
+        for (auto&& worker : Workers) {
+            worker.Channel.Reset();
+        }
+        auto config = Config.Server;
+        config.Load = Loads + index;
+        if (Config.Mode == EPreforkMode::Handoff) {
+            Listener.Reset();
+            config.Source = EConnectionSource::Handoff;
+            RunWorker(TSocket{std::move(channel), TSocketAddress{ESocket::UNIX}}, config);
+        } else {
+            channel.Reset();
+            RunWorker(std::move(Listener), config);
+        }
+    } catch (const TChannelClosed&) {
+        // the supervisor stopped handing connections off
+    } catch (...) {
+        code = 1;
+    }
+    // the worker must not unwind into the code that started the supervisor
+    _exit(code);
+}
+
+void NInternal::TPreforkSupervisor::Reap() {
+    for (std::size_t i = 0; i < Workers.size(); ++i) {
+        auto& worker = Workers[i];
+        if (worker.Pid > 0) {
+            int status;
+            auto res = waitpid(worker.Pid, std::addressof(status), WNOHANG);
+            if (res == 0 || (res < 0 && errno == EINTR)) {
+                continue;
+            }
+        }
+        worker.Pid = -1;
+        worker.Channel.Reset();
+        Start(i);
+    }
+}
+
+void NInternal::TPreforkSupervisor::Dispatch(const IFd& fd, const TSocketAddress& peer) {
+    std::vector<bool> failed(Workers.size(), false);
+    for (std::size_t attempt = 0; attempt < Workers.size(); ++attempt) {
+        auto best = Workers.size();
+        auto bestLoad = std::numeric_limits<std::size_t>::max();
+        for (std::size_t i = 0; i < Workers.size(); ++i) {
+            auto load = GetLoad(i);
+            if (!failed[i] && Workers[i].Pid > 0 && load < bestLoad) {
+                best = i;
+                bestLoad = load;
+            }
+        }
+        if (best == Workers.size()) {
+            break;
+        }
+        Loads[best].fetch_add(1, std::memory_order_relaxed);
+        try {
+            SendConnection(Workers[best].Channel, fd, peer);
+            return;
+        } catch (const std::system_error&) {
+            // the worker is dead or stuck, it's restarted by Reap if it exits
+            Loads[best].fetch_sub(1, std::memory_order_relaxed);
+            failed[best] = true;
+        }
+    }
+    // no worker could take the connection, it's closed by the caller
+}
+
+void NInternal::TPreforkSupervisor::Stop() noexcept {
+    for (auto&& worker : Workers) {
+        // handoff workers also stop once their channel is closed
+        worker.Channel.Reset();
+        if (worker.Pid > 0) {
+            kill(worker.Pid, SIGTERM);
+        }
+    }
+    for (auto&& worker : Workers) {
+        if (worker.Pid > 0) {
+            int status;
+            while (waitpid(worker.Pid, std::addressof(status), 0) < 0 && errno == EINTR) {
+            }
+            worker.Pid = -1;
+        }
+    }
+}
@@ -0,0 +1,118 @@
+#pragma once
+
+#include <posix/net/server.h>
+#include <async/stop_token/stop_token.h>
+
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <vector>
+
+enum class EPreforkMode : unsigned char {
+    // the supervisor accepts and passes every connection to the least loaded
+    // worker with SCM_RIGHTS
+    Handoff,
+    // workers accept from the listener they inherited
+    SharedListener
+};
+
+struct TPreforkConfig {
+    std::size_t Workers = 4;
+    EPreforkMode Mode = EPreforkMode::Handoff;
+    // every worker runs a TServer with this config
+    TServerConfig Server;
+    // how often dead workers are looked for
+    std::chrono::milliseconds Tick{100};
+};
+
+namespace NInternal {
+    // Forks the workers and forks a worker again once it exits, the listener
+    // stays open in the supervisor all along. Worker loads are counted in
+    // memory shared with the workers
+    class TPreforkSupervisor {
+    public:
+        TPreforkSupervisor(TSocket&& listener, TPreforkConfig config);
+
+        TPreforkSupervisor(const TPreforkSupervisor&) = delete;
+        TPreforkSupervisor& operator=(const TPreforkSupervisor&) = delete;
+
+        // terminates the workers
+        virtual ~TPreforkSupervisor();
+
+        // workers are forked on the first call, it's best made before the
+        // process starts other threads
+        void Supervise(TStopToken& token);
+
+        [[nodiscard]]
+        const TSocket& GetSocket() const noexcept;
+
+        // pids of the running workers, -1 for a worker being restarted
+        [[nodiscard]]
+        std::vector<int> GetWorkers() const;
+
+        [[nodiscard]]
+        std::size_t GetLoad(std::size_t worker) const noexcept;
+
+    protected:
+        // runs in the worker process, the source is the listener or a handoff channel
+        virtual void RunWorker(TSocket&& source, TServerConfig config) = 0;
+
+    private:
+        struct TWorker {
+            int Pid;
+            TUniqueFd Channel;
+        };
+
+    private:
+        void Start(std::size_t index);
+
+        [[noreturn]]
+        void RunChild(std::size_t index, TUniqueFd&& channel) noexcept;
+
+        void Reap();
+
+        void Dispatch(const IFd& fd, const TSocketAddress& peer);
+
+        void Stop() noexcept;
+
+    private:
+        TSocket Listener;
+        TPreforkConfig Config;
+        std::atomic<std::size_t>* Loads;
+        std::vector<TWorker> Workers;
+    };
+}
+
+// Runs TServer in Workers forked processes behind one listening address, so a
+// crashing worker takes down only its own connections
+template <typename TReplier>
+class TPreforkServer : public NInternal::TPreforkSupervisor {
+public:
+    TPreforkServer(TReplier replier, int port, int connects, TPreforkConfig config = {})
+        : TPreforkSupervisor{NInternal::ListenIP(port, connects, config.Server.Options), config}
+        , Replier(std::move(replier))
+    {}
+
+    TPreforkServer(TReplier replier, const std::filesystem::path& socketPath, int connects, TPreforkConfig config = {})
+        : TPreforkSupervisor{NInternal::ListenUNIX(socketPath, connects, config.Server.Options), config}
+        , Replier(std::move(replier))
+    {}
+
+    void operator()() {
+        TStopToken token;
+        Supervise(token);
+    }
+
+    void operator()(TStopToken& token) {
+        Supervise(token);
+    }
+
+protected:
+    void RunWorker(TSocket&& source, TServerConfig config) override {
+        TServer<TReplier> server{Replier, std::move(source), config};
+        server();
+    }
+
+private:
+    TReplier Replier;
+};
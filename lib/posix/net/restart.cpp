@@ -0,0 +1,152 @@
+#include "restart.h"
+
+#include <posix/subprocess/subprocess.h>
+
+#include <util/exception/exception.h>
+#include <util/string/utils.h>
+
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cstdlib>
+#include <string_view>
+#include <system_error>
+
+namespace {
+    // a comma separated list of the inherited fds
+    constexpr std::string_view InheritedFdsVariable = "K_INHERITED_FDS";
+
+    ESocket GetSocketType(int fd) {
+        sockaddr_storage address{};
+        socklen_t length = sizeof(address);
+        if (getsockname(fd, reinterpret_cast<sockaddr*>(std::addressof(address)), std::addressof(length)) < 0) {
+            throw std::system_error{std::error_code{errno, std::system_category()}};
+        }
+        switch (address.ss_family) {
+            case AF_INET:
+                return ESocket::IP;
+            case AF_INET6:
+                return ESocket::IP6;
+            case AF_LOCAL:
+                return ESocket::UNIX;
+            default:
+                throw TException{"Inherited fd ", fd, " has an unsupported address family"};
+        }
+    }
+
+    // a listener is addressed by its own name, a connection by its peer's
+    TSocketAddress GetAddress(int fd, bool listening) {
+        TSocketAddress address{GetSocketType(fd)};
+        socklen_t length = TSocketAddress::Capacity();
+        auto res = listening
+            ? getsockname(fd, address.Data(), std::addressof(length))
+            : getpeername(fd, address.Data(), std::addressof(length));
+        if (res < 0) {
+            throw std::system_error{std::error_code{errno, std::system_category()}};
+        }
+        address.SetLength(length);
+        return address;
+    }
+
+    // a null terminated array for exec, pointing into strings
+    std::vector<char*> Prepare(std::vector<std::string>& strings) {
+        std::vector<char*> prepared;
+        prepared.reserve(strings.size() + 1);
+        for (auto&& cur : strings) {
+            prepared.push_back(cur.data());
+        }
+        prepared.push_back(nullptr);
+        return prepared;
+    }
+
+    bool IsListening(int fd) {
+        int listening = 0;
+        socklen_t length = sizeof(listening);
+        if (getsockopt(fd, SOL_SOCKET, SO_ACCEPTCONN, std::addressof(listening), std::addressof(length)) < 0) {
+            throw std::system_error{std::error_code{errno, std::system_category()}};
+        }
+        return listening != 0;
+    }
+}
+
+NRestart::TInheritedSockets NRestart::InheritSockets() {
+    TInheritedSockets inherited;
+    auto variable = std::getenv(InheritedFdsVariable.data());
+    if (variable == nullptr) {
+        return inherited;
+    }
+    std::string fds{variable};
+    unsetenv(InheritedFdsVariable.data());
+
+    for (auto&& token : Split(fds, ",")) {
+        if (token.empty()) {
+            continue;
+        }
+        auto fd = std::stoi(std::string{token});
+        TUniqueFd socket{fd};
+        if (fcntl(fd, F_SETFD, FD_CLOEXEC) < 0) {
+            throw std::system_error{std::error_code{errno, std::system_category()}};
+        }
+        if (IsListening(fd)) {
+            auto address = GetAddress(fd, true);
+            inherited.Listeners.emplace_back(std::move(socket), address);
+        } else {
+            auto address = GetAddress(fd, false);
+            inherited.Connections.emplace_back(std::move(socket), address);
+        }
+    }
+    return inherited;
+}
+
+int NRestart::Start(
+    const std::filesystem::path& executable,
+    const std::vector<std::string>& args,
+    const std::vector<const IFd*>& sockets)
+{
+    std::vector<int> inherited;
+    inherited.reserve(sockets.size());
+    std::string fds;
+    for (auto socket : sockets) {
+        inherited.push_back(socket->Get());
+        if (!fds.empty()) {
+            fds += ',';
+        }
+        fds += std::to_string(socket->Get());
+    }
+
+    std::vector<std::string> env;
+    for (auto cur = environ; *cur != nullptr; ++cur) {
+        std::string_view var{*cur};
+        if (!var.starts_with(InheritedFdsVariable) || var.substr(InheritedFdsVariable.size(), 1) != "=") {
+            env.emplace_back(var);
+        }
+    }
+    env.push_back(std::string{InheritedFdsVariable} + "=" + fds);
+
+    auto path = TSubprocess::FindExecutablePath(executable);
+    std::vector<std::string> argv{path.string()};
+    argv.insert(argv.end(), args.begin(), args.end());
+    auto preparedArgs = Prepare(argv);
+    auto preparedEnv = Prepare(env);
+
+    int pid = fork();
+    if (pid < 0) {
+        throw std::system_error{std::error_code{errno, std::system_category()}};
+    }
+    if (pid == 0) {
+        // Only the child's copies lose close-on-exec, so a process another
+        // thread starts meanwhile doesn't get the sockets. Nothing but async
+        // signal safe calls here, the parent may have other threads
+        setsid();
+        for (auto fd : inherited) {
+            int flags = fcntl(fd, F_GETFD);
+            if (flags < 0 || fcntl(fd, F_SETFD, flags & ~FD_CLOEXEC) < 0) {
+                _exit(127);
+            }
+        }
+        execve(path.c_str(), preparedArgs.data(), preparedEnv.data());
+        _exit(127);
+    }
+    return pid;
+}
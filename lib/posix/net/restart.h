@@ -0,0 +1,32 @@
+#pragma once
+
+#include <posix/net/socket.h>
+
+#include <filesystem>
+#include <string>
+#include <vector>
+
+// Zero-downtime restart: the running process starts the new binary with its
+// listening sockets inherited, then stops accepting and drains (see
+// TServerConfig::DrainTimeout). Both processes accept from the same sockets
+// meanwhile, so the backlog is never dropped
+namespace NRestart {
+    struct TInheritedSockets {
+        std::vector<TSocket> Listeners;
+        std::vector<TConnectedSocket> Connections;
+    };
+
+    // Takes over the sockets passed by Start, nothing if the process wasn't
+    // started by it. The sockets aren't passed on to processes started later
+    TInheritedSockets InheritSockets();
+
+    // Starts the executable with the sockets inherited and returns its pid.
+    // The sockets stay open in this process. A server passes all of its
+    // GetListeners(), its SO_REUSEPORT shards get connections too, and the new
+    // process serves the inherited Listeners together. Connections are passed
+    // as they are, so only idle ones this process won't read from again should be
+    int Start(
+        const std::filesystem::path& executable,
+        const std::vector<std::string>& args,
+        const std::vector<const IFd*>& sockets);
+}
@@ -3,16 +3,18 @@
 #include <sys/socket.h>
 #include <netinet/in.h>
 #include <sys/un.h>
+#include <arpa/inet.h>
+#include <sys/poll.h>
+
+#include <posix/net/fd_passing.h>
 
 #include <util/exception/exception.h>
 
 #include <cstring>
 
 namespace {
-    template <typename TSocketAddress>
-    void Bind(TSocket& socket, TSocketAddress& socketAddress) {
-        auto addrPtr = reinterpret_cast<sockaddr*>(std::addressof(socketAddress));
-        if (bind(socket.Get(), addrPtr, sizeof(socketAddress)) < 0) {
+    void Bind(TSocket& socket) {
+        if (bind(socket.Get(), socket.Data(), socket.GetLength()) < 0) {
             throw std::system_error{std::error_code{errno, std::system_category()}};
         }
     }
@@ -22,61 +24,169 @@ namespace {
             throw std::system_error{std::error_code{errno, std::system_category()}};
         }
     }
+
+    void UpdateAddress(TSocket& socket) {
+        socklen_t addrLen = TSocketAddress::Capacity();
+        if (getsockname(socket.Get(), socket.Data(), std::addressof(addrLen)) < 0) {
+            throw std::system_error{std::error_code{errno, std::system_category()}};
+        }
+        socket.SetLength(addrLen);
+    }
 }
 
-void NInternal::InitIPSocket(TSocket& socket, int port, int connects) {
+void NInternal::InitIPSocket(TSocket& socket, int port, int connects, const TSocketOptions& options) {
     auto& sockAddr = socket.Address<sockaddr_in>();
-    sockAddr.sin_family = AF_INET;
     sockAddr.sin_port = htons(port);
     sockAddr.sin_addr.s_addr = INADDR_ANY;
+    if (auto& address = options.GetBindAddress()) {
+        if (inet_pton(AF_INET, address->c_str(), std::addressof(sockAddr.sin_addr)) != 1) {
+            throw TException{"Wrong bind address ", *address};
+        }
+    }
 
-    Bind(socket, sockAddr);
+    options.ApplyListening(socket, ESocket::IP);
+
+    Bind(socket);
+    UpdateAddress(socket);
     Listen(socket, connects);
 }
 
-void NInternal::InitUNIXSocket(TSocket& socket, const std::filesystem::path& socketPath, int connects) {
+void NInternal::InitUNIXSocket(
+    TSocket& socket, const std::filesystem::path& socketPath, int connects, const TSocketOptions& options)
+{
     auto& sockAddr = socket.Address<sockaddr_un>();
-    sockAddr.sun_family = AF_LOCAL;
     std::strncpy(sockAddr.sun_path, socketPath.c_str(), sizeof(sockAddr.sun_path) - 1);
 
-    Bind(socket, sockAddr);
+    options.ApplyListening(socket, ESocket::UNIX);
+
+    Bind(socket);
     Listen(socket, connects);
 }
 
+TSocket NInternal::ListenIP(int port, int connects, const TSocketOptions& options) {
+    TSocket socket{ESocket::IP};
+    InitIPSocket(socket, port, connects, options);
+    return socket;
+}
+
+TSocket NInternal::ListenUNIX(const std::filesystem::path& socketPath, int connects, const TSocketOptions& options) {
+    TSocket socket{ESocket::UNIX};
+    InitUNIXSocket(socket, socketPath, connects, options);
+    return socket;
+}
+
 void NInternal::ReleaseUnixAddress(TSocket& socket) {
     auto& sockAddr = socket.Address<sockaddr_un>();
     std::filesystem::path unixAddress = sockAddr.sun_path;
     remove(unixAddress);
 }
 
+void NInternal::SetReusePort(TSocket& socket) {
+    int enable = 1;
+    if (setsockopt(socket.Get(), SOL_SOCKET, SO_REUSEPORT, std::addressof(enable), sizeof(enable)) < 0) {
+        throw std::system_error{std::error_code{errno, std::system_category()}};
+    }
+}
+
+int NInternal::GetPort(const TSocket& socket) {
+    if (socket.GetType() == ESocket::IP6) {
+        return ntohs(socket.Address<sockaddr_in6>().sin6_port);
+    }
+    return ntohs(socket.Address<sockaddr_in>().sin_port);
+}
+
+namespace {
+    int AcceptFd(const TSocket& socket, sockaddr* address, socklen_t* length, bool nonBlocking) {
+        // accepted fds must not leak into subprocesses
+        int flags = SOCK_CLOEXEC;
+        if (nonBlocking) {
+            flags |= SOCK_NONBLOCK;
+        }
+        return accept4(socket.Get(), address, length, flags);
+    }
+
+    std::pair<int, TSocketAddress> AcceptImpl(const TSocket& socket, bool nonBlocking) {
+        TSocketAddress sockAddr{socket.GetType()};
+        socklen_t sockLen = TSocketAddress::Capacity();
+        int fd = AcceptFd(socket, sockAddr.Data(), std::addressof(sockLen), nonBlocking);
+        sockAddr.SetLength(sockLen);
+        return {fd, sockAddr};
+    }
+}
+
 TConnectedSocket NInternal::Accept(const TSocket& socket) {
-    int fd;
-    TSocketAddress sockAddr{socket.GetType()};
-    switch (socket.GetType()) {
-        case ESocket::IP: {
-            sockAddr.Emplace<sockaddr_in>();
-            socklen_t sockLen = sizeof(sockaddr_in);
-            fd = accept(
-                socket.Get(),
-                reinterpret_cast<sockaddr*>(sockAddr.AddressPtr<sockaddr_in>()),
-                std::addressof(sockLen));
-            break;
+    while (true) {
+        auto [fd, sockAddr] = AcceptImpl(socket, false);
+        if (fd >= 0) {
+            return {TUniqueFd{fd}, sockAddr};
         }
-        case ESocket::UNIX: {
-            sockAddr.Emplace<sockaddr_un>();
-            socklen_t sockLen = sizeof(sockaddr_un);
-            fd = accept(
-                socket.Get(),
-                reinterpret_cast<sockaddr*>(sockAddr.AddressPtr<sockaddr_un>()),
-                std::addressof(sockLen));
-            break;
+        if (errno == EINTR || errno == ECONNABORTED) {
+            continue;
+        }
+        if (errno != EAGAIN && errno != EWOULDBLOCK) {
+            throw std::system_error{std::error_code{errno, std::system_category()}};
+        }
+        // the listener is non-blocking, e.g. inherited across a restart
+        pollfd pfd{socket.Get(), POLLIN, 0};
+        if (poll(std::addressof(pfd), 1, -1) < 0 && errno != EINTR) {
+            throw std::system_error{std::error_code{errno, std::system_category()}};
         }
-        default:
-            throw TException{"Unknown socket type in accept"};
     }
+}
 
+std::optional<TConnectedSocket> NInternal::TryAccept(const TSocket& socket, bool nonBlocking) {
+    auto accepted = TryAcceptFd(socket, nonBlocking);
+    if (!accepted) {
+        return std::nullopt;
+    }
+    return TConnectedSocket{std::move(accepted->first), accepted->second};
+}
+
+std::optional<std::pair<TUniqueFd, TSocketAddress>> NInternal::TryAcceptFd(const TSocket& socket, bool nonBlocking) {
+    auto [fd, sockAddr] = AcceptImpl(socket, nonBlocking);
     if (fd < 0) {
+        if (errno == EAGAIN || errno == EWOULDBLOCK || errno == ECONNABORTED || errno == EINTR) {
+            return std::nullopt;
+        }
         throw std::system_error{std::error_code{errno, std::system_category()}};
     }
-    return {TUniqueFd{fd}, std::move(sockAddr)};
+    return std::pair{TUniqueFd{fd}, sockAddr};
+}
+
+// the peer address travels as the payload, it's trivially copyable
+void NInternal::SendConnection(const IFd& channel, const IFd& fd, const TSocketAddress& peer) {
+    int fds[] = {fd.Get()};
+    SendFds(channel, fds, std::as_bytes(std::span{std::addressof(peer), 1}));
+}
+
+TConnectedSocket NInternal::ReceiveConnection(const TSocket& channel) {
+    while (true) {
+        if (auto socket = TryReceiveConnection(channel)) {
+            return std::move(*socket);
+        }
+        // the channel is non-blocking, e.g. shared with reactors
+        pollfd pfd{channel.Get(), POLLIN, 0};
+        if (poll(std::addressof(pfd), 1, -1) < 0 && errno != EINTR) {
+            throw std::system_error{std::error_code{errno, std::system_category()}};
+        }
+    }
+}
+
+std::optional<TConnectedSocket> NInternal::TryReceiveConnection(const TSocket& channel, bool nonBlocking) {
+    TUniqueFd fds[1];
+    TSocketAddress peer{ESocket::IP};
+    auto received = ReceiveFds(channel, fds, std::as_writable_bytes(std::span{std::addressof(peer), 1}));
+    if (!received) {
+        return std::nullopt;
+    }
+    if (received->first == 0) {
+        throw TChannelClosed{"Connection channel is closed"};
+    }
+    if (received->first != sizeof(peer) || received->second != 1) {
+        throw TException{"Malformed connection handoff"};
+    }
+    if (nonBlocking) {
+        SetNonBlocking(fds[0]);
+    }
+    return TConnectedSocket{std::move(fds[0]), peer};
 }
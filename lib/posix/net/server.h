@@ -1,58 +1,558 @@
 #pragma once
 
+#include <posix/net/admission.h>
 #include <posix/net/socket.h>
+#include <posix/net/socket_pool.h>
+#include <posix/net/socket_options.h>
 #include <async/stop_token/stop_token.h>
 
+#include <util/exception/exception.h>
+
 #include <filesystem>
 
+#include <algorithm>
 #include <any>
 #include <atomic>
+#include <chrono>
+#include <exception>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <utility>
+#include <vector>
 
 namespace NInternal {
+    // the sending side has closed a handoff channel, there's no more work
+    // coming rather than a failure
+    class TChannelClosed : public TException {
+    public:
+        using TException::TException;
+    };
+
     TConnectedSocket Accept(const TSocket& socket);
 
-    void InitIPSocket(TSocket& socket, int port, int connects);
+    // accepted fds are close-on-exec, nullopt is returned once the backlog is empty
+    std::optional<TConnectedSocket> TryAccept(const TSocket& socket, bool nonBlocking = false);
+
+    // the raw fd and peer address, without setting a stream up
+    std::optional<std::pair<TUniqueFd, TSocketAddress>> TryAcceptFd(const TSocket& socket, bool nonBlocking = false);
+
+    // Passes an accepted connection to another process over a unix channel
+    void SendConnection(const IFd& channel, const IFd& fd, const TSocketAddress& peer);
+
+    TConnectedSocket ReceiveConnection(const TSocket& channel);
+
+    // throws TChannelClosed once the sending side has closed the channel
+    std::optional<TConnectedSocket> TryReceiveConnection(const TSocket& channel, bool nonBlocking = false);
+
+    void InitIPSocket(TSocket& socket, int port, int connects, const TSocketOptions& options = {});
 
-    void InitUNIXSocket(TSocket& socket, const std::filesystem::path& socketPath, int connects);
+    void InitUNIXSocket(
+        TSocket& socket, const std::filesystem::path& socketPath, int connects, const TSocketOptions& options = {});
+
+    TSocket ListenIP(int port, int connects, const TSocketOptions& options = {});
+
+    TSocket ListenUNIX(const std::filesystem::path& socketPath, int connects, const TSocketOptions& options = {});
 
     void ReleaseUnixAddress(TSocket& socket);
+
+    void SetReusePort(TSocket& socket);
+
+    int GetPort(const TSocket& socket);
 }
 
+enum class EConnectionSource : unsigned char {
+    // the server socket is a listener
+    Accept,
+    // the server socket is a unix channel connections are sent to by
+    // another process with NInternal::SendConnection
+    Handoff
+};
+
+struct TServerConfig {
+    // 0 keeps the single blocking accept loop on the calling thread
+    std::size_t Reactors = 0;
+    // With more than one reactor every reactor listens on its own SO_REUSEPORT
+    // socket, otherwise they share one. Any process of the same user can then
+    // bind the port too and take a share of the connections
+    bool ReusePort = false;
+    std::size_t PoolCapacity = 1024;
+    // a reactor stops accepting once it serves this many connections and
+    // resumes when one of them closes, 0 means up to PoolCapacity
+    std::size_t MaxInFlight = 0;
+    EPollBackend Backend = EPollBackend::Epoll;
+    std::chrono::milliseconds Tick{100};
+    // reactors busy-poll this long before blocking, see TSocketPool::SetSpinBudget
+    std::chrono::microseconds SpinBudget{0};
+    // set on listeners at bind time and inherited by accepted connections
+    TSocketOptions Options;
+    EConnectionSource Source = EConnectionSource::Accept;
+    // Connections being served: incremented by whoever accepts a connection
+    // and decremented by the server once it's done with it. It may live in
+    // memory shared between processes
+    std::atomic<std::size_t>* Load = nullptr;
+    // Once stopped, reactors stop accepting and keep serving the open
+    // connections for up to this long, e.g. while a restarted process takes
+    // the listener over. Blocking servers have nothing to drain
+    std::chrono::milliseconds DrainTimeout{0};
+    // rejected connections are closed right away, shedding closes a
+    // connection instead of replying, as the server doesn't know the protocol
+    TAdmissionConfig Admission;
+};
+
+// A replier invocable with TConnectedSocket takes the connection over and
+// returning false stops the server. A replier invocable with TConnectedSocket&
+// is run by reactors each time the connection is readable and returning false
+// closes the connection; it is called concurrently from all reactor threads.
+// Its connections are non-blocking: a read that would block fails with
+// WouldBlock() set, the replier returns true and is run again once more of
+// the request arrives, keeping what it has parsed so far itself. Output that
+// would block stays buffered and is written once the connection is writable.
 template <typename TReplier>
 class TServer {
-    static_assert(std::is_invocable_r_v<bool, TReplier, TConnectedSocket>);
+    static constexpr bool IsValueReplier = std::is_invocable_r_v<bool, TReplier&, TConnectedSocket>;
+    static constexpr bool IsReactorReplier = std::is_invocable_r_v<bool, TReplier&, TConnectedSocket&>;
+
+    static_assert(IsValueReplier || IsReactorReplier);
 
 public:
-    TServer(TReplier replier, int port, int connects)
+    TServer(TReplier replier, int port, int connects, TServerConfig config = {})
         : Socket{ESocket::IP}
+        , Shards{}
         , Replier(std::move(replier))
+        , Config{config}
+        , Adopted{}
+        , Admission{config.Admission}
+        , OwnsAddress{true}
     {
-        NInternal::InitIPSocket(Socket, port, connects);
+        if (IsSharded()) {
+            NInternal::SetReusePort(Socket);
+        }
+        NInternal::InitIPSocket(Socket, port, connects, Config.Options);
+        if (IsSharded()) {
+            for (std::size_t i = 1; i < Config.Reactors; ++i) {
+                auto& shard = Shards.emplace_back(ESocket::IP);
+                NInternal::SetReusePort(shard);
+                NInternal::InitIPSocket(shard, NInternal::GetPort(Socket), connects, Config.Options);
+            }
+        }
+        InitListeners();
     }
 
-    TServer(TReplier replier, const std::filesystem::path& socketPath, int connects)
+    TServer(TReplier replier, const std::filesystem::path& socketPath, int connects, TServerConfig config = {})
         : Socket{ESocket::UNIX}
+        , Shards{}
+        , Replier(std::move(replier))
+        , Config{config}
+        , Adopted{}
+        , Admission{config.Admission}
+        , OwnsAddress{true}
+    {
+        NInternal::InitUNIXSocket(Socket, socketPath, connects, Config.Options);
+        InitListeners();
+    }
+
+    // Takes over a socket that is already listening, or a handoff channel.
+    // All reactors share it and a unix address is left to its owner
+    TServer(TReplier replier, TSocket&& socket, TServerConfig config = {})
+        : Socket{std::move(socket)}
+        , Shards{}
         , Replier(std::move(replier))
+        , Config{config}
+        , Adopted{}
+        , Admission{config.Admission}
+        , OwnsAddress{false}
     {
-        NInternal::InitUNIXSocket(Socket, socketPath, connects);
+        InitListeners();
+    }
+
+    // Takes over all the listeners of a server, as returned by GetListeners
+    // and inherited across a restart. The first is shared like above, the
+    // others are its SO_REUSEPORT shards. Every listener needs a reactor, the
+    // reactors are spread over them round robin
+    TServer(TReplier replier, std::vector<TSocket>&& sockets, TServerConfig config = {})
+        : Socket{TakeFirst(sockets)}
+        , Shards{std::move(sockets)}
+        , Replier(std::move(replier))
+        , Config{config}
+        , Adopted{}
+        , Admission{config.Admission}
+        , OwnsAddress{false}
+    {
+        if (!Shards.empty() && Shards.size() >= Config.Reactors) {
+            throw TException{"Serving ", Shards.size() + 1, " listeners takes as many reactors"};
+        }
+        InitListeners();
     }
 
     virtual ~TServer() {
-        if (Socket.GetType() == ESocket::UNIX) {
+        if (OwnsAddress && Socket.GetType() == ESocket::UNIX) {
             NInternal::ReleaseUnixAddress(Socket);
         }
     }
 
 public:
     virtual void operator()() {
-        while (Replier(NInternal::Accept(Socket)));
+        if constexpr (IsValueReplier) {
+            if (!IsReactorMode()) {
+                if (PassAdopted()) {
+                    while (Pass(Next(), IsCounted()));
+                }
+                return;
+            }
+        }
+        TStopToken token;
+        RunReactors(token);
     }
 
     virtual void operator()(TStopToken& token) {
-        while (!token && Replier(NInternal::Accept(Socket)));
+        if constexpr (IsValueReplier) {
+            if (!IsReactorMode()) {
+                if (PassAdopted()) {
+                    while (!token && Pass(Next(), IsCounted()));
+                }
+                return;
+            }
+        }
+        RunReactors(token);
+    }
+
+    // Connections opened elsewhere, e.g. inherited across a restart, are
+    // served first once the server runs. Reactors share them round robin
+    void Adopt(std::vector<TConnectedSocket>&& connections) {
+        for (auto&& connection : connections) {
+            Adopted.push_back(std::move(connection));
+        }
+        connections.clear();
+    }
+
+    [[nodiscard]]
+    const TSocket& GetSocket() const noexcept {
+        return Socket;
+    }
+
+    // the socket and its shards, all of them have to be passed on a restart
+    [[nodiscard]]
+    std::vector<const IFd*> GetListeners() const {
+        std::vector<const IFd*> listeners{std::addressof(Socket)};
+        for (auto&& shard : Shards) {
+            listeners.push_back(std::addressof(shard));
+        }
+        return listeners;
+    }
+
+    [[nodiscard]]
+    TAdmissionStats GetAdmissionStats() const noexcept {
+        return Admission.GetStats();
+    }
+
+private:
+    [[nodiscard]]
+    bool IsReactorMode() const noexcept {
+        return Config.Reactors > 0 || !IsValueReplier;
+    }
+
+    [[nodiscard]]
+    bool IsSharded() const noexcept {
+        return Config.Reactors > 1 && Config.ReusePort;
+    }
+
+    static TSocket TakeFirst(std::vector<TSocket>& sockets) {
+        if (sockets.empty()) {
+            throw TException{"No listeners to serve"};
+        }
+        TSocket first{std::move(sockets.front())};
+        sockets.erase(sockets.begin());
+        return first;
+    }
+
+    void InitListeners() {
+        if (IsReactorMode()) {
+            NInternal::SetNonBlocking(Socket);
+            for (auto&& shard : Shards) {
+                NInternal::SetNonBlocking(shard);
+            }
+        }
+    }
+
+    const TSocket& Listener(std::size_t reactor) const noexcept {
+        auto index = reactor % (Shards.size() + 1);
+        if (index == 0) {
+            return Socket;
+        }
+        return Shards[index - 1];
+    }
+
+    void RunReactors(TStopToken& token) {
+        TStopToken stopped;
+        std::mutex errorMutex;
+        std::exception_ptr error;
+        auto reactor = [&](std::size_t index) {
+            try {
+                Serve(index, token, stopped);
+            } catch (...) {
+                std::lock_guard lock{errorMutex};
+                if (!error) {
+                    error = std::current_exception();
+                }
+                stopped.Stop();
+            }
+        };
+
+        std::vector<std::thread> threads;
+        auto reactors = std::max<std::size_t>(Config.Reactors, 1);
+        threads.reserve(reactors - 1);
+        for (std::size_t i = 1; i < reactors; ++i) {
+            threads.emplace_back(reactor, i);
+        }
+        reactor(0);
+        for (auto&& thread : threads) {
+            thread.join();
+        }
+        Adopted.clear();
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+
+    [[nodiscard]]
+    std::size_t MaxInFlight() const noexcept {
+        if (Config.MaxInFlight == 0) {
+            return Config.PoolCapacity;
+        }
+        return std::min(Config.MaxInFlight, Config.PoolCapacity);
+    }
+
+    void Serve(std::size_t index, TStopToken& token, TStopToken& stopped) {
+        const auto& listener = Listener(index);
+        TSocketPool pool{Config.PoolCapacity + 1, Config.Backend};
+        pool.SetSpinBudget(Config.SpinBudget);
+        pool.Watch(listener, EPollEvent::IN, 0);
+        bool accepting = true;
+
+        auto reactors = std::max<std::size_t>(Config.Reactors, 1);
+        for (auto i = index; i < Adopted.size() && !stopped; i += reactors) {
+            if constexpr (IsReactorReplier) {
+                NInternal::SetNonBlocking(Adopted[i].GetFd());
+                pool.Add(std::move(Adopted[i]), EPollEvent::IN);
+                Track(false);
+            } else if (!Pass(std::move(Adopted[i]), false)) {
+                stopped.Stop();
+            }
+        }
+
+        auto shedder = Admission.MakeShedder();
+        std::optional<std::chrono::steady_clock::time_point> drainDeadline;
+        std::vector<TSocketPool::TReadyEvent> events(Config.PoolCapacity + 1);
+        while (!stopped) {
+            if (token) {
+                if (!drainDeadline) {
+                    drainDeadline = std::chrono::steady_clock::now() + Config.DrainTimeout;
+                    if (accepting) {
+                        pool.Unwatch(listener);
+                        accepting = false;
+                    }
+                }
+                if (pool.Size() == 0 || std::chrono::steady_clock::now() >= *drainDeadline) {
+                    return;
+                }
+            }
+            shedder.BeforeWait();
+            auto count = pool.Get(events, Config.Tick);
+            shedder.AfterWait();
+            for (std::size_t i = 0; i < count && !stopped; ++i) {
+                auto& event = events[i];
+                if (event.Socket == nullptr) {
+                    Accept(pool, listener, shedder, stopped);
+                } else if constexpr (IsReactorReplier) {
+                    if (shedder.ShouldShed()) {
+                        Admission.Shed();
+                        pool.Remove(*event.Socket);
+                        Untrack();
+                    } else {
+                        Reply(pool, *event.Socket, event.Event);
+                    }
+                }
+            }
+
+            if (drainDeadline) {
+                continue;
+            }
+            // the listener is unwatched while the reactor is at its limit,
+            // pending connections wait in the kernel backlog meanwhile
+            auto inFlight = pool.Size() - (accepting ? 1 : 0);
+            if (accepting && inFlight >= MaxInFlight()) {
+                pool.Unwatch(listener);
+                accepting = false;
+            } else if (!accepting && inFlight < MaxInFlight()) {
+                pool.Watch(listener, EPollEvent::IN, 0);
+                accepting = true;
+            }
+        }
+    }
+
+    // drains the backlog until it's empty or the reactor reaches its limit
+    void Accept(TSocketPool& pool, const TSocket& listener, TReactorShedder& shedder, TStopToken& stopped) {
+        while (!stopped) {
+            if constexpr (IsReactorReplier) {
+                if (pool.Size() - 1 >= MaxInFlight()) {
+                    return;
+                }
+            }
+            auto socket = TryNext(listener);
+            if (!socket) {
+                return;
+            }
+            if (shedder.ShouldShed()) {
+                Admission.Shed();
+                Reject();
+                continue;
+            }
+            if constexpr (IsReactorReplier) {
+                pool.Add(std::move(*socket), EPollEvent::IN);
+                Track(IsCounted());
+            } else {
+                if (!Pass(std::move(*socket), IsCounted())) {
+                    stopped.Stop();
+                }
+            }
+        }
+    }
+
+    TConnectedSocket Next() {
+        while (true) {
+            auto socket = Config.Source == EConnectionSource::Handoff
+                ? NInternal::ReceiveConnection(Socket)
+                : NInternal::Accept(Socket);
+            if (Admit(socket)) {
+                return socket;
+            }
+        }
+    }
+
+    std::optional<TConnectedSocket> TryNext(const TSocket& listener) {
+        while (true) {
+            // a reactor replier must not block its reactor on one connection
+            auto socket = Config.Source == EConnectionSource::Handoff
+                ? NInternal::TryReceiveConnection(listener, IsReactorReplier)
+                : NInternal::TryAccept(listener, IsReactorReplier);
+            if (!socket || Admit(*socket)) {
+                return socket;
+            }
+        }
+    }
+
+    // a handed off connection got its options from the process that accepted it
+    bool Admit(TConnectedSocket& socket) {
+        if (!Admission.Admit(socket)) {
+            Reject();
+            return false;
+        }
+        if (Config.Source == EConnectionSource::Accept) {
+            Config.Options.ApplyAccepted(socket.GetFd(), socket.GetType());
+        }
+        return true;
+    }
+
+    // the connection is closed by its owner
+    void Reject() noexcept {
+        if (IsCounted()) {
+            Untrack();
+        }
+    }
+
+    bool Pass(TConnectedSocket&& socket, bool counted) {
+        Track(counted);
+        bool keep = Replier(std::move(socket));
+        Untrack();
+        return keep;
+    }
+
+    bool PassAdopted() {
+        for (auto&& socket : std::exchange(Adopted, {})) {
+            if (!Pass(std::move(socket), false)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // a handed off connection has been counted by the process that accepted it
+    [[nodiscard]]
+    bool IsCounted() const noexcept {
+        return Config.Source == EConnectionSource::Handoff;
+    }
+
+    void Track(bool counted) noexcept {
+        if (Config.Load != nullptr && !counted) {
+            Config.Load->fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    void Untrack() noexcept {
+        if (Config.Load != nullptr) {
+            Config.Load->fetch_sub(1, std::memory_order_relaxed);
+        }
+    }
+
+    void Reply(TSocketPool& pool, TConnectedSocket& socket, TSocketPool::TEvent event) {
+        if (event.Err() || (!event.In() && !event.Out())) {
+            Close(pool, socket);
+            return;
+        }
+        if (event.Out()) {
+            // the rest of a response that didn't fit into the socket buffer
+            socket.flush();
+            if (!Resume(socket)) {
+                Close(pool, socket);
+                return;
+            }
+            if (socket.Unflushed() > 0) {
+                return;
+            }
+            pool.Set(socket, EPollEvent::IN);
+        }
+        // the stream may have buffered more than one request
+        bool readable = event.In();
+        while (readable || socket.rdbuf()->in_avail() > 0) {
+            readable = false;
+            if (!Replier(socket) || !Resume(socket)) {
+                Close(pool, socket);
+                return;
+            }
+            if (socket.Unflushed() > 0) {
+                // requests are read again once the response is written
+                pool.Set(socket, EPollEvent::OUT);
+                return;
+            }
+        }
+        // an idle connection keeps no buffers
+        socket.Trim();
+    }
+
+    // a connection that only waits for the socket to become ready goes on
+    static bool Resume(TConnectedSocket& socket) {
+        if (socket.good()) {
+            return true;
+        }
+        if (!socket.WouldBlock()) {
+            return false;
+        }
+        socket.clear();
+        return true;
+    }
+
+    void Close(TSocketPool& pool, TConnectedSocket& socket) {
+        pool.Remove(socket);
+        Untrack();
     }
 
 private:
     TSocket Socket;
+    std::vector<TSocket> Shards;
     TReplier Replier;
+    TServerConfig Config;
+    std::vector<TConnectedSocket> Adopted;
+    TAdmission Admission;
+    bool OwnsAddress;
 };
@@ -7,20 +7,122 @@
 #include <system_error>
 #include <sys/un.h>
 #include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <string_view>
+
+static_assert(std::is_trivially_copyable_v<TSocketAddress>);
+
+TSocketAddress::TSocketAddress(ESocket type) noexcept
+    : Storage{}
+    , Length{0}
+    , Type{type}
+{
+    switch (type) {
+        case ESocket::IP:
+            Storage.ss_family = AF_INET;
+            Length = sizeof(sockaddr_in);
+            break;
+        case ESocket::IP6:
+            Storage.ss_family = AF_INET6;
+            Length = sizeof(sockaddr_in6);
+            break;
+        case ESocket::UNIX:
+            Storage.ss_family = AF_LOCAL;
+            Length = sizeof(sockaddr_un);
+            break;
+    }
+}
+
+sockaddr* TSocketAddress::Data() noexcept {
+    return reinterpret_cast<sockaddr*>(std::addressof(Storage));
+}
+
+const sockaddr* TSocketAddress::Data() const noexcept {
+    return reinterpret_cast<const sockaddr*>(std::addressof(Storage));
+}
+
+socklen_t TSocketAddress::GetLength() const noexcept {
+    return Length;
+}
+
+void TSocketAddress::SetLength(socklen_t length) noexcept {
+    Length = std::min(length, Capacity());
+}
 
 ESocket TSocketAddress::GetType() const noexcept {
     return Type;
 }
 
-TSocketAddress::TSocketAddress(TSocketAddress&& address) noexcept
-    : SocketAddress{std::move(address.SocketAddress)}
-    , Type{address.Type}
-{}
+namespace {
+    std::string_view TypeName(ESocket type) noexcept {
+        switch (type) {
+            case ESocket::IP:
+                return "IP";
+            case ESocket::IP6:
+                return "IP6";
+            case ESocket::UNIX:
+                return "UNIX";
+        }
+        return "unknown";
+    }
+}
 
-TSocketAddress& TSocketAddress::operator=(TSocketAddress&& address) noexcept {
-    SocketAddress = std::move(address.SocketAddress);
-    Type = address.Type;
-    return *this;
+void TSocketAddress::CheckType(ESocket expected) const {
+    if (Type != expected) {
+        throw TException{"An ", TypeName(Type), " socket address read as ", TypeName(expected)};
+    }
+}
+
+std::size_t TSocketAddress::Format(std::span<char> buffer) const noexcept {
+    std::array<char, MaxFormattedSize> text{};
+    char* end = text.data();
+    auto appendPort = [&](in_port_t port) {
+        *end++ = ':';
+        end = std::to_chars(end, text.data() + text.size(), ntohs(port)).ptr;
+    };
+    // read by the stored family unchecked, formatting never throws
+    switch (Storage.ss_family) {
+        case AF_INET: {
+            auto& address = *reinterpret_cast<const sockaddr_in*>(std::addressof(Storage));
+            inet_ntop(AF_INET, std::addressof(address.sin_addr), end, INET_ADDRSTRLEN);
+            end += std::strlen(end);
+            appendPort(address.sin_port);
+            break;
+        }
+        case AF_INET6: {
+            auto& address = *reinterpret_cast<const sockaddr_in6*>(std::addressof(Storage));
+            *end++ = '[';
+            inet_ntop(AF_INET6, std::addressof(address.sin6_addr), end, INET6_ADDRSTRLEN);
+            end += std::strlen(end);
+            *end++ = ']';
+            appendPort(address.sin6_port);
+            break;
+        }
+        case AF_LOCAL: {
+            auto& address = *reinterpret_cast<const sockaddr_un*>(std::addressof(Storage));
+            constexpr std::string_view prefix = "unix:";
+            end = std::copy(prefix.begin(), prefix.end(), end);
+            // an accepted unix socket has no path
+            auto path = std::string_view{address.sun_path, strnlen(address.sun_path, sizeof(address.sun_path))};
+            end = std::copy(path.begin(), path.end(), end);
+            break;
+        }
+        default:
+            break;
+    }
+    auto size = std::min<std::size_t>(end - text.data(), buffer.size());
+    std::copy_n(text.data(), size, buffer.data());
+    return size;
+}
+
+std::ostream& operator<<(std::ostream& out, const TSocketAddress& address) {
+    std::array<char, TSocketAddress::MaxFormattedSize> buffer{};
+    auto size = address.Format(buffer);
+    return out.write(buffer.data(), static_cast<std::streamsize>(size));
 }
 
 namespace {
@@ -33,11 +135,14 @@ namespace {
             case ESocket::UNIX:
                 type = PF_LOCAL;
                 break;
+            case ESocket::IP6:
+                type = PF_INET6;
+                break;
             default:
                 throw TException{"Wrong socket type"};
         }
 
-        if (int fd = socket(type, SOCK_STREAM, 0); fd != -1) {
+        if (int fd = socket(type, SOCK_STREAM | SOCK_CLOEXEC, 0); fd != -1) {
             return TUniqueFd{fd};
         }
         throw std::system_error{std::error_code{errno, std::system_category()}};
@@ -47,34 +152,22 @@ namespace {
 TSocket::TSocket(ESocket socketType)
     : TUniqueFd{AcquireTCPSocket(socketType)}
     , TSocketAddress{socketType}
-{
-    switch (socketType) {
-        case ESocket::IP:
-            SocketAddress.emplace<sockaddr_in>();
-            break;
-        case ESocket::UNIX:
-            SocketAddress.emplace<sockaddr_un>();
-            break;
-        default:
-            throw TException{"Wrong socket type"};
-    }
-}
+{}
 
-TConnectedSocket::TConnectedSocket(TUniqueFd&& fd, const TSocketAddress& sockAddr)
-    : TFdStream{std::move(fd)}
-    , TSocketAddress{sockAddr}
-    , Id{GetFd().Get()}
+TSocket::TSocket(TUniqueFd&& fd, const TSocketAddress& address) noexcept
+    : TUniqueFd{std::move(fd)}
+    , TSocketAddress{address}
 {}
 
-TConnectedSocket::TConnectedSocket(TUniqueFd&& fd, TSocketAddress&& sockAddr)
+TConnectedSocket::TConnectedSocket(TUniqueFd&& fd, const TSocketAddress& sockAddr)
     : TFdStream{std::move(fd)}
-    , TSocketAddress{std::move(sockAddr)}
+    , TSocketAddress{sockAddr}
     , Id{GetFd().Get()}
 {}
 
 TConnectedSocket::TConnectedSocket(TConnectedSocket&& other) noexcept
-    : TFdStream{std::move(dynamic_cast<TFdStream&>(other))}
-    , TSocketAddress{std::move(dynamic_cast<TSocketAddress&>(other))}
+    : TFdStream{std::move(static_cast<TFdStream&>(other))}
+    , TSocketAddress{other}
     , Id{0}
 {
     std::swap(Id, other.Id);
@@ -87,8 +180,8 @@ TConnectedSocket::~TConnectedSocket() {
 }
 
 TConnectedSocket& TConnectedSocket::operator=(TConnectedSocket&& other) noexcept {
-    dynamic_cast<TFdStream&>(*this) = std::move(dynamic_cast<TFdStream&>(other));
-    dynamic_cast<TSocketAddress&>(*this) = std::move(dynamic_cast<TSocketAddress&>(other));
+    static_cast<TFdStream&>(*this) = std::move(static_cast<TFdStream&>(other));
+    static_cast<TSocketAddress&>(*this) = other;
     auto tmpId = other.Id;
     other.Id = 0;
     Id = tmpId;
@@ -101,26 +194,12 @@ int TConnectedSocket::GetId() const noexcept {
 
 namespace {
     void ReconnectImpl(TConnectedSocket& socket, bool shut = true) {
-        sockaddr* addrPtr;
-        std::size_t addrLen;
-        switch (socket.GetType()) {
-            case ESocket::IP:
-                addrPtr = reinterpret_cast<sockaddr*>(socket.AddressPtr<sockaddr_in>());
-                addrLen = sizeof(socket.Address<sockaddr_in>());
-                break;
-            case ESocket::UNIX:
-                addrPtr = reinterpret_cast<sockaddr*>(socket.AddressPtr<sockaddr_un>());
-                addrLen = sizeof(socket.Address<sockaddr_un>());
-                break;
-            default:
-                throw TException{"Wrong socket type"};
-        }
         if (shut) {
             if (shutdown(socket.GetFd().Get(), SHUT_RDWR) < 0) {
                 throw std::system_error{std::error_code{errno, std::system_category()}};
             }
         }
-        if (connect(socket.GetFd().Get(), addrPtr, addrLen) < 0) {
+        if (connect(socket.GetFd().Get(), socket.Data(), socket.GetLength()) < 0) {
             throw std::system_error{std::error_code{errno, std::system_category()}};
         }
     }
@@ -132,10 +211,7 @@ TConnectedSocket& Reconnect(TConnectedSocket& socket) {
 }
 
 TConnectedSocket Connect(TSocket&& socket) {
-    TConnectedSocket connected{
-        std::move(dynamic_cast<TUniqueFd&>(socket)),
-        std::move(dynamic_cast<TSocketAddress&>(socket))
-    };
+    TConnectedSocket connected{std::move(static_cast<TUniqueFd&>(socket)), static_cast<const TSocketAddress&>(socket)};
     ReconnectImpl(connected, false);
     return connected;
 }
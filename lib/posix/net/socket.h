@@ -2,78 +2,125 @@
 
 #include <posix/file_descriptor/fd_stream.h>
 
-#include <any>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include <cstring>
 #include <filesystem>
+#include <ostream>
+#include <span>
+#include <type_traits>
 
 enum class ESocket : unsigned char {
     IP,
-    UNIX
+    UNIX,
+    IP6
 };
 
+// The address is kept inline in a sockaddr_storage, so the class is trivially
+// copyable and taking an address from accept doesn't allocate
 class TSocketAddress {
 public:
-    template <typename... TArgs>
-    explicit TSocketAddress(ESocket type, TArgs&&... args)
-        : SocketAddress{std::forward<TArgs>(args)...}
-        , Type{type}
-    {}
-
-    virtual ~TSocketAddress() = default;
-
-    TSocketAddress(const TSocketAddress& address) = default;
+    // longest formatted address: a unix path with its prefix
+    static constexpr std::size_t MaxFormattedSize = 128;
 
-    TSocketAddress(TSocketAddress&& address) noexcept;
-
-    TSocketAddress& operator=(const TSocketAddress& address) = default;
-
-    TSocketAddress& operator=(TSocketAddress&& address) noexcept;
+public:
+    explicit TSocketAddress(ESocket type) noexcept;
 
+    // throws if TSockAddr isn't the structure of the address type,
+    // sockaddr and sockaddr_storage fit any
     template <typename TSockAddr>
     TSockAddr& Address() {
-        return std::any_cast<TSockAddr&>(SocketAddress);
+        CheckType<TSockAddr>();
+        return *reinterpret_cast<TSockAddr*>(std::addressof(Storage));
     }
 
     template <typename TSockAddr>
     TSockAddr* AddressPtr() {
-        return std::addressof(std::any_cast<TSockAddr&>(SocketAddress));
+        return std::addressof(Address<TSockAddr>());
     }
 
     template <typename TSockAddr>
     const TSockAddr& Address() const {
-        return std::any_cast<const TSockAddr&>(SocketAddress);
+        CheckType<TSockAddr>();
+        return *reinterpret_cast<const TSockAddr*>(std::addressof(Storage));
     }
 
     template <typename TSockAddr>
     const TSockAddr* AddressPtr() const {
-        return std::addressof(std::any_cast<const TSockAddr&>(SocketAddress));
+        return std::addressof(Address<TSockAddr>());
     }
 
     template <typename TSockAddr, typename... TArgs>
     void Emplace(TArgs&&... args) {
-        SocketAddress.emplace<TSockAddr>(std::forward<TArgs>(args)...);
+        CheckType<TSockAddr>();
+        TSockAddr address{std::forward<TArgs>(args)...};
+        std::memcpy(std::addressof(Storage), std::addressof(address), sizeof(address));
+        Length = sizeof(address);
+    }
+
+    [[nodiscard]]
+    sockaddr* Data() noexcept;
+
+    [[nodiscard]]
+    const sockaddr* Data() const noexcept;
+
+    [[nodiscard]]
+    socklen_t GetLength() const noexcept;
+
+    // for calls that fill the address in, e.g. accept or getsockname
+    void SetLength(socklen_t length) noexcept;
+
+    [[nodiscard]]
+    static constexpr socklen_t Capacity() noexcept {
+        return sizeof(sockaddr_storage);
     }
 
     [[nodiscard]]
     ESocket GetType() const noexcept;
 
-protected:
-    std::any SocketAddress;
+    // writes "host:port", "[host]:port" or "unix:path" without allocating,
+    // the result is truncated to the buffer and its length is returned
+    std::size_t Format(std::span<char> buffer) const noexcept;
+
+private:
+    template <typename TSockAddr>
+    void CheckType() const {
+        static_assert(std::is_trivially_copyable_v<TSockAddr> && sizeof(TSockAddr) <= sizeof(sockaddr_storage));
+        if constexpr (std::is_same_v<TSockAddr, sockaddr_in>) {
+            CheckType(ESocket::IP);
+        } else if constexpr (std::is_same_v<TSockAddr, sockaddr_in6>) {
+            CheckType(ESocket::IP6);
+        } else if constexpr (std::is_same_v<TSockAddr, sockaddr_un>) {
+            CheckType(ESocket::UNIX);
+        } else {
+            static_assert(std::is_same_v<TSockAddr, sockaddr> || std::is_same_v<TSockAddr, sockaddr_storage>);
+        }
+    }
+
+    void CheckType(ESocket expected) const;
 
 private:
+    sockaddr_storage Storage;
+    socklen_t Length;
     ESocket Type;
 };
 
+std::ostream& operator<<(std::ostream& out, const TSocketAddress& address);
+
 class TSocket : public TUniqueFd, public TSocketAddress {
 public:
     explicit TSocket(ESocket socketType);
+
+    // wraps a socket created elsewhere, e.g. inherited or received from another process
+    TSocket(TUniqueFd&& fd, const TSocketAddress& address) noexcept;
 };
 
 class TConnectedSocket : public TFdStream, public TSocketAddress {
 public:
     TConnectedSocket(TUniqueFd&& fd, const TSocketAddress& sockAddr);
 
-    TConnectedSocket(TUniqueFd&& fd, TSocketAddress&& sockAddr);
-
     TConnectedSocket(TConnectedSocket&& other) noexcept;
 
     ~TConnectedSocket() override;
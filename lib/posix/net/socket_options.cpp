@@ -0,0 +1,166 @@
+#include "socket_options.h"
+
+#include <util/exception/exception.h>
+
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+#include <system_error>
+
+namespace {
+    void SetOption(const IFd& fd, int level, int name, int value) {
+        if (setsockopt(fd.Get(), level, name, std::addressof(value), sizeof(value)) < 0) {
+            throw std::system_error{std::error_code{errno, std::system_category()}};
+        }
+    }
+
+    [[noreturn, maybe_unused]]
+    void Unsupported(const char* option) {
+        throw TException{"Socket option ", option, " is not supported on this platform"};
+    }
+}
+
+TSocketOptions& TSocketOptions::NoDelay(bool enable) {
+    NoDelayFlag = enable;
+    return *this;
+}
+
+TSocketOptions& TSocketOptions::QuickAck(bool enable) {
+    QuickAckFlag = enable;
+    return *this;
+}
+
+TSocketOptions& TSocketOptions::DeferAccept(std::chrono::seconds timeout) {
+    DeferAcceptTimeout = timeout;
+    return *this;
+}
+
+TSocketOptions& TSocketOptions::FastOpen(int queue) {
+    FastOpenQueue = queue;
+    return *this;
+}
+
+TSocketOptions& TSocketOptions::BusyPoll(std::chrono::microseconds budget) {
+    BusyPollBudget = budget;
+    return *this;
+}
+
+TSocketOptions& TSocketOptions::SendBuffer(int size) {
+    SendBufferSize = size;
+    return *this;
+}
+
+TSocketOptions& TSocketOptions::ReceiveBuffer(int size) {
+    ReceiveBufferSize = size;
+    return *this;
+}
+
+TSocketOptions& TSocketOptions::ReuseAddress(bool enable) {
+    ReuseAddressFlag = enable;
+    return *this;
+}
+
+TSocketOptions& TSocketOptions::ReusePort(bool enable) {
+    ReusePortFlag = enable;
+    return *this;
+}
+
+TSocketOptions& TSocketOptions::IncomingCpu(int cpu) {
+    IncomingCpuId = cpu;
+    return *this;
+}
+
+TSocketOptions& TSocketOptions::BindAddress(std::string address) {
+    Address = std::move(address);
+    return *this;
+}
+
+const std::optional<std::string>& TSocketOptions::GetBindAddress() const noexcept {
+    return Address;
+}
+
+void TSocketOptions::ApplyListening(const IFd& fd, ESocket type) const {
+    ApplyCommon(fd, type);
+    if (ReuseAddressFlag) {
+        SetOption(fd, SOL_SOCKET, SO_REUSEADDR, *ReuseAddressFlag);
+    }
+    if (ReusePortFlag) {
+        SetOption(fd, SOL_SOCKET, SO_REUSEPORT, *ReusePortFlag);
+    }
+    if (type == ESocket::UNIX) {
+        return;
+    }
+    if (DeferAcceptTimeout) {
+#ifdef TCP_DEFER_ACCEPT
+        SetOption(fd, IPPROTO_TCP, TCP_DEFER_ACCEPT, static_cast<int>(DeferAcceptTimeout->count()));
+#else
+        Unsupported("TCP_DEFER_ACCEPT");
+#endif
+    }
+    if (FastOpenQueue) {
+#ifdef TCP_FASTOPEN
+        SetOption(fd, IPPROTO_TCP, TCP_FASTOPEN, *FastOpenQueue);
+#else
+        Unsupported("TCP_FASTOPEN");
+#endif
+    }
+}
+
+void TSocketOptions::ApplyConnecting(const IFd& fd, ESocket type) const {
+    ApplyCommon(fd, type);
+    if (ReuseAddressFlag) {
+        SetOption(fd, SOL_SOCKET, SO_REUSEADDR, *ReuseAddressFlag);
+    }
+    if (type != ESocket::UNIX && FastOpenQueue) {
+#ifdef TCP_FASTOPEN_CONNECT
+        SetOption(fd, IPPROTO_TCP, TCP_FASTOPEN_CONNECT, *FastOpenQueue > 0);
+#else
+        Unsupported("TCP_FASTOPEN_CONNECT");
+#endif
+    }
+}
+
+void TSocketOptions::ApplyAccepted(const IFd& fd, ESocket type) const {
+    if (type == ESocket::UNIX) {
+        return;
+    }
+    if (QuickAckFlag) {
+#ifdef TCP_QUICKACK
+        SetOption(fd, IPPROTO_TCP, TCP_QUICKACK, *QuickAckFlag);
+#else
+        Unsupported("TCP_QUICKACK");
+#endif
+    }
+}
+
+void TSocketOptions::ApplyCommon(const IFd& fd, ESocket type) const {
+    // buffer sizes must be known before the handshake to pick the window scale
+    if (SendBufferSize) {
+        SetOption(fd, SOL_SOCKET, SO_SNDBUF, *SendBufferSize);
+    }
+    if (ReceiveBufferSize) {
+        SetOption(fd, SOL_SOCKET, SO_RCVBUF, *ReceiveBufferSize);
+    }
+    if (BusyPollBudget) {
+#ifdef SO_BUSY_POLL
+        SetOption(fd, SOL_SOCKET, SO_BUSY_POLL, static_cast<int>(BusyPollBudget->count()));
+#else
+        Unsupported("SO_BUSY_POLL");
+#endif
+    }
+    if (IncomingCpuId) {
+#ifdef SO_INCOMING_CPU
+        SetOption(fd, SOL_SOCKET, SO_INCOMING_CPU, *IncomingCpuId);
+#else
+        Unsupported("SO_INCOMING_CPU");
+#endif
+    }
+    if (type == ESocket::UNIX) {
+        return;
+    }
+    if (NoDelayFlag) {
+        SetOption(fd, IPPROTO_TCP, TCP_NODELAY, *NoDelayFlag);
+    }
+    ApplyAccepted(fd, type);
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <posix/file_descriptor/fd.h>
+#include <posix/net/socket.h>
+
+#include <chrono>
+#include <optional>
+#include <string>
+
+// Options applied to a socket before it's bound or connected, unset ones keep
+// the system defaults. TCP options are skipped for unix sockets.
+class TSocketOptions {
+public:
+    TSocketOptions& NoDelay(bool enable = true);
+
+    // not sticky in the kernel, so it's also set on every accepted socket
+    TSocketOptions& QuickAck(bool enable = true);
+
+    // accept wakes up only once data arrives or the timeout passes
+    TSocketOptions& DeferAccept(std::chrono::seconds timeout);
+
+    // a queue length for listeners, connecting sockets only check it's positive
+    TSocketOptions& FastOpen(int queue);
+
+    TSocketOptions& BusyPoll(std::chrono::microseconds budget);
+
+    TSocketOptions& SendBuffer(int size);
+
+    TSocketOptions& ReceiveBuffer(int size);
+
+    TSocketOptions& ReuseAddress(bool enable = true);
+
+    TSocketOptions& ReusePort(bool enable = true);
+
+    TSocketOptions& IncomingCpu(int cpu);
+
+    // IPv4 address to bind to, listeners bind to any address and connecting
+    // sockets to an ephemeral one by default
+    TSocketOptions& BindAddress(std::string address);
+
+    [[nodiscard]]
+    const std::optional<std::string>& GetBindAddress() const noexcept;
+
+    void ApplyListening(const IFd& fd, ESocket type) const;
+
+    void ApplyConnecting(const IFd& fd, ESocket type) const;
+
+    // the kernel copies the listener's options to accepted sockets, except the ones set here
+    void ApplyAccepted(const IFd& fd, ESocket type) const;
+
+private:
+    void ApplyCommon(const IFd& fd, ESocket type) const;
+
+private:
+    std::optional<bool> NoDelayFlag;
+    std::optional<bool> QuickAckFlag;
+    std::optional<std::chrono::seconds> DeferAcceptTimeout;
+    std::optional<int> FastOpenQueue;
+    std::optional<std::chrono::microseconds> BusyPollBudget;
+    std::optional<int> SendBufferSize;
+    std::optional<int> ReceiveBufferSize;
+    std::optional<bool> ReuseAddressFlag;
+    std::optional<bool> ReusePortFlag;
+    std::optional<int> IncomingCpuId;
+    std::optional<std::string> Address;
+};
@@ -3,28 +3,8 @@
 #include <sys/poll.h>
 #include <util/exception/exception.h>
 
-#include <vector>
-
-namespace {
-    std::vector<pollfd>& AsPollFds(std::any& pollFds) {
-        return std::any_cast<std::vector<pollfd>&>(pollFds);
-    }
-
-    short ConvertEvent(EPollEvent event) {
-        switch (event) {
-            case EPollEvent::IN:
-                return POLLIN;
-            case EPollEvent::OUT:
-                return POLLOUT;
-            case EPollEvent::ERR:
-                return POLLERR;
-            case EPollEvent::HUP:
-                return POLLHUP;
-            default:
-                return 0;
-        }
-    }
-}
+#include <array>
+#include <limits>
 
 TSocketPool::TEvent::TEvent(short event) noexcept
     : Event(event)
@@ -47,76 +27,430 @@ bool TSocketPool::TEvent::Err() const noexcept {
 }
 
 namespace {
-    std::pair<TIFdStream, TOFdStream> InitPipe() {
-        auto [in, out] = NInternal::Pipe();
-        return {TIFdStream{std::move(in)}, TOFdStream{std::move(out)}};
-    }
+    // not used by poll(2), so it can't collide with a real event
+    constexpr short TimeoutEvent = 0x4000;
+
+    constexpr auto NotWaiting = std::numeric_limits<TTimerWheel::TClock::rep>::min();
+    constexpr auto WaitingForever = std::numeric_limits<TTimerWheel::TClock::rep>::max();
+}
+
+bool TSocketPool::TEvent::Timeout() const noexcept {
+    return (Event & static_cast<unsigned short>(TimeoutEvent)) != 0;
 }
 
-TSocketPool::TSocketPool(std::size_t capacity)
-    : Mutex{}
+namespace {
+    // WakeupState bits: the polling thread is (about to be) blocked in Wait,
+    // a wakeup has already been sent since it went to sleep
+    constexpr unsigned Sleeping = 1;
+    constexpr unsigned Signalled = 2;
+}
+
+TSocketPool::TSocketPool(std::size_t capacity, EPollBackend backend, EPollTrigger trigger, EPoolRegistration registration)
+    : Registration{registration}
+    , Mutex{}
     , Sockets{}
-    , Pipe{InitPipe()}
-    , PollFds{std::in_place_type_t<std::vector<pollfd>>{}}
+    , Count{0}
+    , Commands{}
+    , Owner{}
+    , RemovedSockets{}
+    , Retired{}
+    , HasRemoved{false}
+    , Notifier{NInternal::EventFd()}
+    , WakeupState{0}
+    , Capacity{capacity}
+    , Poller{NInternal::MakePoller(backend, trigger, capacity)}
+    , Ready(capacity + 1)
+    , Handled{}
+    , SpinBudget{0}
+    , Spins{0}
+    , SpinHits{0}
+    , SpinBlocks{0}
+    , SpinPolls{0}
+    , TimerMutex{}
+    , Timers{}
+    , Expired(capacity + 1)
+    , WaitingUntil{NotWaiting}
 {
     Sockets.reserve(capacity);
-    AsPollFds(PollFds).reserve(capacity + 1);
+    RemovedSockets.reserve(capacity);
+    Handled.reserve(capacity);
+    Poller->Add(Notifier.first.Get(), EPollEvent::IN, 0);
 }
 
 std::vector<TSocketPool::TPollEvent> TSocketPool::Get(std::chrono::milliseconds timeout) {
-    auto& pollFds = AsPollFds(PollFds);
-    pollFds.clear();
-
-    std::shared_lock lock{Mutex};
-    pollFds.emplace_back();
-    pollFds.back().fd = Pipe.first.GetFd().Get();
-    pollFds.back().events = ConvertEvent(EPollEvent::IN);
-    pollFds.back().revents = 0;
-    for (auto&& [wrapper, pollEvent] : Sockets) {
-        auto&& [socket, event] = pollEvent;
-        pollFds.emplace_back();
-        pollFds.back().fd = socket.GetFd().Get();
-        pollFds.back().events = ConvertEvent(event);
-        pollFds.back().revents = 0;
-    }
-    lock.unlock();
+    std::vector<TReadyEvent> events(Ready.size());
+    events.resize(Get(events, timeout));
 
     std::vector<TSocketPool::TPollEvent> result;
-    if (int res = poll(pollFds.data(), pollFds.size(), timeout.count()); res == -1) {
-        throw std::system_error{std::error_code{errno, std::system_category()}};
-    } else if (res > 0) {
-        static char command;
-        lock.lock();
+    result.reserve(events.size());
+    for (auto&& event : events) {
+        if (event.Socket != nullptr) {
+            result.emplace_back(*event.Socket, event.Event);
+        }
+    }
+    return result;
+}
 
-        if (!pollFds.empty() && TEvent{pollFds.front().revents}.In()) {
-            Pipe.first >> command;
-            pollFds.front().revents = 0;
+std::size_t TSocketPool::Get(std::span<TReadyEvent> events, std::chrono::milliseconds timeout) {
+    if (events.empty()) {
+        throw TException{"Empty event buffer"};
+    }
+    Owner.store(std::this_thread::get_id(), std::memory_order_relaxed);
+    ReleaseRemoved();
+
+    // set before queued commands are applied, the timeout is computed and the
+    // interest set is read, so a racing change either is seen here or sends a wakeup
+    WakeupState.exchange(Sleeping, std::memory_order_seq_cst);
+    ApplyCommands();
+    auto count = Wait(std::span{Ready}.first(std::min(Ready.size(), events.size())), WaitTimeout(timeout));
+    WakeupState.store(0, std::memory_order_relaxed);
+    WaitingUntil.store(NotWaiting, std::memory_order_relaxed);
+
+    std::size_t result = 0;
+    Handled.clear();
+    if (count != 0) {
+        std::shared_lock lock{Mutex, std::defer_lock};
+        if (Registration == EPoolRegistration::Locked) {
+            lock.lock();
         }
-        for (auto fd = pollFds.begin() + 1; fd != pollFds.end(); ++fd) {
-            if (auto& pollEvent = Sockets.at(fd->fd); fd->revents != 0) {
-                result.emplace_back(pollEvent.first, TEvent{fd->revents});
+        for (std::size_t i = 0; i < count; ++i) {
+            auto entry = reinterpret_cast<TEntry*>(Ready[i].Data);
+            if (entry == nullptr) {
+                DrainNotifier();
+            } else if (entry->Removed) {
+                continue;
+            } else if (entry->Handler) {
+                Handled.emplace_back(entry, TEvent{Ready[i].Events});
+            } else {
+                auto socket = entry->Socket ? std::addressof(*entry->Socket) : nullptr;
+                events[result++] = TReadyEvent{socket, entry->Cookie, TEvent{Ready[i].Events}};
             }
         }
     }
-    return result;
+    // removed entries live until the next Get, so a handler may remove any of
+    // them. Handlers run unlocked, so they may change the pool themselves
+    for (auto&& [entry, event] : Handled) {
+        if (!IsRemoved(*entry)) {
+            entry->Handler(event);
+        }
+    }
+    return result + ExpireTimers(events.subspan(result));
 }
 
 void TSocketPool::Add(TConnectedSocket&& socket, EPollEvent event) {
-    std::unique_lock lock{Mutex};
-    if (AsPollFds(PollFds).capacity() < Sockets.size()) {
-        throw TException{"Too many sockets in pool"};
-    }
+    Add(std::move(socket), event, 0);
+}
+
+void TSocketPool::Add(TConnectedSocket&& socket, EPollEvent event, std::uint64_t cookie) {
     auto id = socket.GetId();
-    Sockets.emplace(id, std::pair{std::move(socket), event});
-    Pipe.second << '0' << std::flush;
+    Insert(id, TEntry{std::move(socket), TUniqueFd{}, nullptr, event, cookie, false});
+}
+
+void TSocketPool::Add(TUniqueFd&& fd, EPollEvent event, std::uint64_t cookie) {
+    auto id = fd.Get();
+    Insert(id, TEntry{std::nullopt, std::move(fd), nullptr, event, cookie, false});
+}
+
+void TSocketPool::Add(TUniqueFd&& fd, EPollEvent event, THandler handler) {
+    auto id = fd.Get();
+    Insert(id, TEntry{std::nullopt, std::move(fd), std::move(handler), event, 0, false});
 }
 
 void TSocketPool::Set(const TConnectedSocket& socket, EPollEvent event) {
-    std::unique_lock lock{Mutex};
-    Sockets.at(socket.GetId()).second = event;
+    Update(socket.GetId(), event);
+}
+
+void TSocketPool::Set(const IFd& fd, EPollEvent event) {
+    Update(fd.Get(), event);
 }
 
 void TSocketPool::Remove(const TConnectedSocket& event) {
-    std::unique_lock lock{Mutex};
-    Sockets.erase(event.GetId());
+    Erase(event.GetId());
+}
+
+void TSocketPool::Watch(const IFd& fd, EPollEvent event, std::uint64_t cookie) {
+    Insert(fd.Get(), TEntry{std::nullopt, TUniqueFd{}, nullptr, event, cookie, false});
+}
+
+void TSocketPool::Watch(const IFd& fd, EPollEvent event, THandler handler) {
+    Insert(fd.Get(), TEntry{std::nullopt, TUniqueFd{}, std::move(handler), event, 0, false});
+}
+
+void TSocketPool::Unwatch(const IFd& fd) {
+    Erase(fd.Get());
+}
+
+TSocketPool::TTimerId TSocketPool::ArmTimer(std::chrono::milliseconds delay, std::uint64_t cookie) {
+    std::lock_guard lock{TimerMutex};
+    auto deadline = TTimerWheel::TClock::now() + delay;
+    auto id = Timers.Arm(deadline, cookie);
+    // a poller blocked for longer than the new timer has to recompute its timeout
+    if (deadline.time_since_epoch().count() < WaitingUntil.load(std::memory_order_relaxed)) {
+        Notify();
+    }
+    return id;
+}
+
+bool TSocketPool::CancelTimer(TTimerId id) {
+    std::lock_guard lock{TimerMutex};
+    return Timers.Cancel(id);
+}
+
+std::size_t TSocketPool::Size() const {
+    return Count.load(std::memory_order_relaxed);
+}
+
+void TSocketPool::Insert(int fd, TEntry&& entry) {
+    Reserve();
+    if (Deferred()) {
+        Commands.Push(TCommand{ECommand::Add, fd, std::move(entry)});
+        Notify();
+        return;
+    }
+    auto lock = LockTable();
+    ApplyInsert(fd, std::move(entry));
+    Wakeup();
+}
+
+void TSocketPool::Update(int fd, EPollEvent event) {
+    if (Deferred()) {
+        Commands.Push(TCommand{ECommand::Set, fd, TEntry{std::nullopt, TUniqueFd{}, nullptr, event, 0, false}});
+        Notify();
+        return;
+    }
+    auto lock = LockTable();
+    ApplySet(fd, Sockets.at(fd), event);
+    Wakeup();
+}
+
+void TSocketPool::Erase(int fd) {
+    if (Deferred()) {
+        Commands.Push(TCommand{ECommand::Remove, fd, TEntry{std::nullopt, TUniqueFd{}, nullptr, EPollEvent::IN, 0, false}});
+        Notify();
+        return;
+    }
+    auto lock = LockTable();
+    ApplyErase(fd);
+}
+
+void TSocketPool::Reserve() {
+    if (Count.fetch_add(1, std::memory_order_relaxed) >= Capacity) {
+        Count.fetch_sub(1, std::memory_order_relaxed);
+        throw TException{"Too many sockets in pool"};
+    }
+}
+
+bool TSocketPool::Deferred() const noexcept {
+    return Registration == EPoolRegistration::Queued
+        && Owner.load(std::memory_order_relaxed) != std::this_thread::get_id();
+}
+
+std::unique_lock<std::shared_mutex> TSocketPool::LockTable() {
+    if (Registration == EPoolRegistration::Locked) {
+        return std::unique_lock{Mutex};
+    }
+    return std::unique_lock{Mutex, std::defer_lock};
+}
+
+void TSocketPool::ApplyInsert(int fd, TEntry&& entry) {
+    auto event = entry.Event;
+    auto [it, inserted] = Sockets.emplace(fd, std::move(entry));
+    if (!inserted) {
+        Count.fetch_sub(1, std::memory_order_relaxed);
+        throw TException{"Fd ", fd, " is already in pool"};
+    }
+    try {
+        Poller->Add(fd, event, reinterpret_cast<std::uint64_t>(std::addressof(it->second)));
+    } catch (...) {
+        Sockets.erase(it);
+        Count.fetch_sub(1, std::memory_order_relaxed);
+        throw;
+    }
+}
+
+void TSocketPool::ApplySet(int fd, TEntry& entry, EPollEvent event) {
+    entry.Event = event;
+    Poller->Set(fd, event, reinterpret_cast<std::uint64_t>(std::addressof(entry)));
+}
+
+void TSocketPool::ApplyErase(int fd) {
+    auto node = Sockets.extract(fd);
+    if (node.empty()) {
+        return;
+    }
+    Poller->Remove(fd);
+    Count.fetch_sub(1, std::memory_order_relaxed);
+
+    // the poller may still hold a pointer to the entry and a handler may be
+    // running, so only the fd is closed here and the entry lives until the next Get
+    auto& entry = node.mapped();
+    if constexpr (NInternal::IoCountersEnabled) {
+        if (entry.Socket) {
+            Retired += entry.Socket->GetCounters();
+        }
+    }
+    entry.Removed = true;
+    entry.Socket.reset();
+    entry.Fd.Reset();
+    RemovedSockets.push_back(std::move(node));
+    HasRemoved.store(true, std::memory_order_release);
+}
+
+bool TSocketPool::IsRemoved(const TEntry& entry) const {
+    // written by ApplyErase under the unique lock, possibly on another thread
+    std::shared_lock lock{Mutex, std::defer_lock};
+    if (Registration == EPoolRegistration::Locked) {
+        lock.lock();
+    }
+    return entry.Removed;
+}
+
+EPollBackend TSocketPool::GetBackend() const noexcept {
+    return Poller->GetBackend();
+}
+
+TIoCounters TSocketPool::GetCounters() const {
+    if constexpr (!NInternal::IoCountersEnabled) {
+        return {};
+    }
+    std::shared_lock lock{Mutex, std::defer_lock};
+    if (Registration == EPoolRegistration::Locked) {
+        lock.lock();
+    }
+    auto counters = Retired;
+    for (auto&& [fd, entry] : Sockets) {
+        if (entry.Socket) {
+            counters += entry.Socket->GetCounters();
+        }
+    }
+    return counters;
+}
+
+void TSocketPool::ReleaseRemoved() {
+    if (!HasRemoved.load(std::memory_order_acquire)) {
+        return;
+    }
+    auto lock = LockTable();
+    RemovedSockets.clear();
+    HasRemoved.store(false, std::memory_order_relaxed);
+}
+
+void TSocketPool::ApplyCommands() {
+    if (Registration != EPoolRegistration::Queued) {
+        return;
+    }
+    while (auto command = Commands.Pop()) {
+        switch (command->Type) {
+            case ECommand::Add:
+                ApplyInsert(command->Fd, std::move(command->Entry));
+                break;
+            case ECommand::Set:
+                // the socket may have been removed by the polling thread meanwhile
+                if (auto it = Sockets.find(command->Fd); it != Sockets.end()) {
+                    ApplySet(command->Fd, it->second, command->Entry.Event);
+                }
+                break;
+            case ECommand::Remove:
+                ApplyErase(command->Fd);
+                break;
+        }
+    }
+}
+
+void TSocketPool::Wakeup() {
+    if (Poller->NeedsWakeup()) {
+        Notify();
+    }
+}
+
+void TSocketPool::Notify() {
+    // only the first notification after the poller went to sleep costs a syscall
+    if (WakeupState.fetch_or(Signalled, std::memory_order_seq_cst) != Sleeping) {
+        return;
+    }
+    std::uint64_t value = 1;
+    NInternal::Write(Notifier.second, reinterpret_cast<const std::byte*>(std::addressof(value)), sizeof(value));
+}
+
+void TSocketPool::DrainNotifier() {
+    std::array<std::uint64_t, 8> buffer{};
+    NInternal::Read(Notifier.first, reinterpret_cast<std::byte*>(buffer.data()), sizeof(buffer));
+}
+
+void TSocketPool::SetSpinBudget(std::chrono::microseconds budget) noexcept {
+    SpinBudget.store(budget.count(), std::memory_order_relaxed);
+}
+
+TSocketPool::TSpinStats TSocketPool::GetSpinStats() const noexcept {
+    return TSpinStats{
+        Spins.load(std::memory_order_relaxed),
+        SpinHits.load(std::memory_order_relaxed),
+        SpinBlocks.load(std::memory_order_relaxed),
+        SpinPolls.load(std::memory_order_relaxed)};
+}
+
+namespace {
+    void Increment(std::atomic<std::uint64_t>& counter, std::uint64_t value = 1) noexcept {
+        counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+    }
+}
+
+// a registration or timer change made while spinning still sends a wakeup, as
+// WakeupState says the thread is sleeping, so it's found by a later poll
+std::size_t TSocketPool::Wait(std::span<IPoller::TReady> ready, std::chrono::milliseconds timeout) {
+    std::chrono::microseconds budget{SpinBudget.load(std::memory_order_relaxed)};
+    if (budget.count() <= 0 || timeout.count() == 0) {
+        return Poller->Wait(ready, timeout);
+    }
+    if (timeout.count() > 0) {
+        budget = std::min<std::chrono::microseconds>(budget, timeout);
+    }
+
+    Increment(Spins);
+    auto start = std::chrono::steady_clock::now();
+    std::uint64_t polls = 0;
+    std::size_t count = 0;
+    do {
+        ++polls;
+        count = Poller->Wait(ready, std::chrono::milliseconds{0});
+    } while (count == 0 && std::chrono::steady_clock::now() - start < budget);
+    Increment(SpinPolls, polls);
+    if (count != 0) {
+        Increment(SpinHits);
+        return count;
+    }
+
+    Increment(SpinBlocks);
+    if (timeout.count() > 0) {
+        auto spent = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+        timeout = std::max(timeout - spent, std::chrono::milliseconds{0});
+    }
+    return Poller->Wait(ready, timeout);
+}
+
+std::chrono::milliseconds TSocketPool::WaitTimeout(std::chrono::milliseconds timeout) {
+    auto now = TTimerWheel::TClock::now();
+    std::lock_guard lock{TimerMutex};
+    if (auto next = Timers.NextTimeout(now)) {
+        auto delay = std::chrono::ceil<std::chrono::milliseconds>(*next);
+        if (timeout.count() < 0 || delay < timeout) {
+            timeout = delay;
+        }
+    }
+    WaitingUntil.store(
+        timeout.count() < 0 ? WaitingForever : (now + timeout).time_since_epoch().count(),
+        std::memory_order_relaxed);
+    return timeout;
+}
+
+std::size_t TSocketPool::ExpireTimers(std::span<TReadyEvent> events) {
+    if (events.empty()) {
+        return 0;
+    }
+    std::lock_guard lock{TimerMutex};
+    auto count = Timers.Advance(TTimerWheel::TClock::now(), std::span{Expired}.first(std::min(Expired.size(), events.size())));
+    for (std::size_t i = 0; i < count; ++i) {
+        events[i] = TReadyEvent{nullptr, Expired[i], TEvent{TimeoutEvent}};
+    }
+    return count;
 }
@@ -1,16 +1,28 @@
 #pragma once
 
 #include <posix/net/socket.h>
+#include <posix/net/poller.h>
+
+#include <async/queue/mpsc_queue.h>
+#include <async/timer/timer_wheel.h>
 
 #include <unordered_map>
+#include <atomic>
 #include <chrono>
+#include <functional>
 #include <shared_mutex>
-
-enum class EPollEvent : unsigned char {
-    IN,
-    OUT,
-    HUP,
-    ERR
+#include <mutex>
+#include <optional>
+#include <span>
+#include <thread>
+#include <vector>
+
+enum class EPoolRegistration : unsigned char {
+    // the fd table is guarded by a lock shared with Get
+    Locked,
+    // calls from other threads are queued and applied by the thread running
+    // Get, which owns the fd table and takes no lock
+    Queued
 };
 
 class TSocketPool {
@@ -31,26 +43,190 @@ public:
         [[nodiscard]]
         bool Err() const noexcept;
 
+        [[nodiscard]]
+        bool Timeout() const noexcept;
+
     private:
         unsigned short Event;
     };
 
     using TPollEvent = std::pair<TConnectedSocket&, TEvent>;
 
+    using TTimerId = TTimerWheel::TTimerId;
+
+    // Run by Get on the polling thread without the table locked, so it may
+    // change the pool. Exceptions it throws propagate out of Get
+    using THandler = std::function<void(TEvent)>;
+
+    struct TReadyEvent {
+        TConnectedSocket* Socket = nullptr;
+        std::uint64_t Cookie = 0;
+        TEvent Event{0};
+    };
+
+    struct TSpinStats {
+        // Get calls that spun, found work while spinning or blocked afterwards
+        std::uint64_t Spins = 0;
+        std::uint64_t Hits = 0;
+        std::uint64_t Blocks = 0;
+        // zero timeout waits made while spinning
+        std::uint64_t Polls = 0;
+    };
+
 public:
-    explicit TSocketPool(std::size_t capacity);
+    explicit TSocketPool(
+        std::size_t capacity,
+        EPollBackend backend = EPollBackend::Epoll,
+        EPollTrigger trigger = EPollTrigger::Level,
+        EPoolRegistration registration = EPoolRegistration::Locked);
 
     std::vector<TPollEvent> Get(std::chrono::milliseconds timeout);
 
+    // Fills caller-owned storage and returns the number of events written.
+    // Sockets removed from the pool are released on the next Get call.
+    // Expired timers are reported with a null socket and the Timeout flag.
+    // In queued mode it also applies pending registrations and rethrows the
+    // errors they cause
+    std::size_t Get(std::span<TReadyEvent> events, std::chrono::milliseconds timeout);
+
     void Add(TConnectedSocket&& socket, EPollEvent event);
 
+    void Add(TConnectedSocket&& socket, EPollEvent event, std::uint64_t cookie);
+
+    // Any other fd owned by the pool, e.g. a timerfd, signalfd or inotify
+    // instance, its events are reported with a null socket
+    void Add(TUniqueFd&& fd, EPollEvent event, std::uint64_t cookie);
+
+    // events of an fd with a handler are passed to it instead of being reported
+    void Add(TUniqueFd&& fd, EPollEvent event, THandler handler);
+
     void Set(const TConnectedSocket& socket, EPollEvent event);
 
+    void Set(const IFd& fd, EPollEvent event);
+
     void Remove(const TConnectedSocket& socket);
 
+    // The fd is polled but not owned by the pool, its events are reported
+    // with a null socket. Subprocess streams are watched by their GetFd()
+    void Watch(const IFd& fd, EPollEvent event, std::uint64_t cookie);
+
+    void Watch(const IFd& fd, EPollEvent event, THandler handler);
+
+    // also closes an fd owned by the pool
+    void Unwatch(const IFd& fd);
+
+    // The cookie is reported by Get once the delay has passed
+    TTimerId ArmTimer(std::chrono::milliseconds delay, std::uint64_t cookie);
+
+    bool CancelTimer(TTimerId id);
+
+    [[nodiscard]]
+    std::size_t Size() const;
+
+    [[nodiscard]]
+    EPollBackend GetBackend() const noexcept;
+
+    // Get polls with a zero timeout for up to the budget before it blocks,
+    // trading a busy core for the wakeup latency. 0 disables spinning
+    void SetSpinBudget(std::chrono::microseconds budget) noexcept;
+
+    [[nodiscard]]
+    TSpinStats GetSpinStats() const noexcept;
+
+    // Sum over the sockets in the pool and the ones already removed from it,
+    // in queued mode it's only consistent on the polling thread
+    [[nodiscard]]
+    TIoCounters GetCounters() const;
+
+private:
+    struct TEntry {
+        std::optional<TConnectedSocket> Socket;
+        TUniqueFd Fd;
+        THandler Handler;
+        EPollEvent Event;
+        std::uint64_t Cookie;
+        bool Removed;
+    };
+
+    using TSockets = std::unordered_map<int, TEntry>;
+
+    enum class ECommand : unsigned char {
+        Add,
+        Set,
+        Remove
+    };
+
+    struct TCommand {
+        ECommand Type;
+        int Fd;
+        TEntry Entry;
+    };
+
+private:
+    void Wakeup();
+
+    void Notify();
+
+    void DrainNotifier();
+
+    std::chrono::milliseconds WaitTimeout(std::chrono::milliseconds timeout);
+
+    std::size_t Wait(std::span<IPoller::TReady> ready, std::chrono::milliseconds timeout);
+
+    std::size_t ExpireTimers(std::span<TReadyEvent> events);
+
+    void Insert(int fd, TEntry&& entry);
+
+    void Update(int fd, EPollEvent event);
+
+    void Erase(int fd);
+
+    void ReleaseRemoved();
+
+    [[nodiscard]]
+    bool IsRemoved(const TEntry& entry) const;
+
+    void Reserve();
+
+    [[nodiscard]]
+    bool Deferred() const noexcept;
+
+    std::unique_lock<std::shared_mutex> LockTable();
+
+    void ApplyInsert(int fd, TEntry&& entry);
+
+    void ApplySet(int fd, TEntry& entry, EPollEvent event);
+
+    void ApplyErase(int fd);
+
+    void ApplyCommands();
+
 private:
+    EPoolRegistration Registration;
     mutable std::shared_mutex Mutex;
-    std::unordered_map<int, std::pair<TConnectedSocket, EPollEvent>> Sockets;
-    std::pair<TIFdStream, TOFdStream> Pipe;
-    mutable std::any PollFds;
+    TSockets Sockets;
+    std::atomic<std::size_t> Count;
+    TMpscQueue<TCommand> Commands;
+    std::atomic<std::thread::id> Owner;
+    std::vector<TSockets::node_type> RemovedSockets;
+    TIoCounters Retired;
+    std::atomic_bool HasRemoved;
+    std::pair<TSharedFd, TSharedFd> Notifier;
+    std::atomic<unsigned> WakeupState;
+    std::size_t Capacity;
+    std::unique_ptr<IPoller> Poller;
+    std::vector<IPoller::TReady> Ready;
+    std::vector<std::pair<TEntry*, TEvent>> Handled;
+
+    // written by the polling thread only
+    std::atomic<std::chrono::microseconds::rep> SpinBudget;
+    std::atomic<std::uint64_t> Spins;
+    std::atomic<std::uint64_t> SpinHits;
+    std::atomic<std::uint64_t> SpinBlocks;
+    std::atomic<std::uint64_t> SpinPolls;
+
+    std::mutex TimerMutex;
+    TTimerWheel Timers;
+    std::vector<std::uint64_t> Expired;
+    std::atomic<TTimerWheel::TClock::rep> WaitingUntil;
 };
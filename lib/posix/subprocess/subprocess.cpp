@@ -4,11 +4,20 @@
 #include <sys/ioctl.h>
 #include <sys/wait.h>
 #include <csignal>
+#include <utility>
 
 #include <util/string/utils.h>
 
 #include <util/exception/exception.h>
 
+namespace {
+    // a stream's Pt mode includes its plain bit, so only the pt bit tells them apart
+    bool UsesPt(TSubprocess::ECommunicationMode mode, TSubprocess::ECommunicationMode stream) {
+        auto bits = static_cast<std::uint_least32_t>(stream) & static_cast<std::uint_least32_t>(TSubprocess::ECommunicationMode::Pt);
+        return (static_cast<std::uint_least32_t>(mode) & bits) != 0;
+    }
+}
+
 TSubprocess::TSubprocess(TSubprocess&& other) noexcept
     : Executable(std::move(other.Executable))
     , Arguments(std::move(other.Arguments))
@@ -63,6 +72,10 @@ TSubprocess::EExitCode TSubprocess::Wait() {
     return EExitCode::Unknown;
 }
 
+int TSubprocess::Detach() noexcept {
+    return std::exchange(ChildPid, -1);
+}
+
 void TSubprocess::Kill() {
     if (ChildPid > 0) {
         if (kill(ChildPid, SIGKILL) < 0) {
@@ -104,7 +117,7 @@ void TSubprocess::ForkExec(ECommunicationMode mode) {
         }
 
         if (mode & ECommunicationMode::In) {
-            if (mode & ECommunicationMode::InPt) {
+            if (UsesPt(mode, ECommunicationMode::InPt)) {
                 inFds = ptFds;
                 std::swap(inFds.first, inFds.second);
             } else {
@@ -112,14 +125,14 @@ void TSubprocess::ForkExec(ECommunicationMode mode) {
             }
         }
         if (mode & ECommunicationMode::Out) {
-            if (mode & ECommunicationMode::OutPt) {
+            if (UsesPt(mode, ECommunicationMode::OutPt)) {
                 outFds = ptFds;
             } else {
                 outFds = NInternal::Pipe();
             }
         }
         if (mode & ECommunicationMode::Err) {
-            if (mode & ECommunicationMode::ErrPt) {
+            if (UsesPt(mode, ECommunicationMode::ErrPt)) {
                 errFds = ptFds;
             } else {
                 errFds = NInternal::Pipe();
@@ -130,38 +143,44 @@ void TSubprocess::ForkExec(ECommunicationMode mode) {
     if ((ChildPid = fork()) < 0) {
         throw std::system_error{std::error_code{errno, std::system_category()}};
     } else if (ChildPid == 0) {
-        setsid();
-        if (ioctl(inFds.first.Get(), TIOCSCTTY, nullptr) < 0) {
-            throw std::system_error{std::error_code{errno, std::system_category()}};
-        }
-        {
-            auto [inRead, inWrite] = std::move(inFds);
-            if (mode & ECommunicationMode::In && dup2(inRead.Get(), STDIN_FILENO) < 0) {
+        // the child must not unwind into the code that started it
+        try {
+            setsid();
+            if (inFds.first && isatty(inFds.first.Get()) && ioctl(inFds.first.Get(), TIOCSCTTY, nullptr) < 0) {
                 throw std::system_error{std::error_code{errno, std::system_category()}};
             }
-        }
-        {
-            auto [outRead, outWrite] = std::move(outFds);
-            if (mode & ECommunicationMode::Out && dup2(outWrite.Get(), STDOUT_FILENO) < 0) {
-                throw std::system_error{std::error_code{errno, std::system_category()}};
+            {
+                auto [inRead, inWrite] = std::move(inFds);
+                if (mode & ECommunicationMode::In && dup2(inRead.Get(), STDIN_FILENO) < 0) {
+                    throw std::system_error{std::error_code{errno, std::system_category()}};
+                }
             }
-        }
-        {
-            auto [errRead, errWrite] = std::move(errFds);
-            if (mode & ECommunicationMode::Err && dup2(errWrite.Get(), STDERR_FILENO) < 0) {
-                throw std::system_error{std::error_code{errno, std::system_category()}};
+            {
+                auto [outRead, outWrite] = std::move(outFds);
+                if (mode & ECommunicationMode::Out && dup2(outWrite.Get(), STDOUT_FILENO) < 0) {
+                    throw std::system_error{std::error_code{errno, std::system_category()}};
+                }
             }
-        }
-
-        if (PreparedEnv.empty()) {
-            if (execv(Executable.c_str(), PreparedArgs.data()) < 0) {
-                throw std::system_error{std::error_code{errno, std::system_category()}};
+            {
+                auto [errRead, errWrite] = std::move(errFds);
+                if (mode & ECommunicationMode::Err && dup2(errWrite.Get(), STDERR_FILENO) < 0) {
+                    throw std::system_error{std::error_code{errno, std::system_category()}};
+                }
             }
-        } else {
-            if (execve(Executable.c_str(), PreparedArgs.data(), PreparedEnv.data()) < 0) {
-                throw std::system_error{std::error_code{errno, std::system_category()}};
+
+            if (PreparedEnv.empty()) {
+                if (execv(Executable.c_str(), PreparedArgs.data()) < 0) {
+                    throw std::system_error{std::error_code{errno, std::system_category()}};
+                }
+            } else {
+                if (execve(Executable.c_str(), PreparedArgs.data(), PreparedEnv.data()) < 0) {
+                    throw std::system_error{std::error_code{errno, std::system_category()}};
+                }
             }
+        } catch (...) {
+            // reported as the exit code
         }
+        _exit(127);
     } else {
         auto [inRead, inWrite] = std::move(inFds);
         auto [outRead, outWrite] = std::move(outFds);
@@ -120,6 +120,9 @@ public:
 
     void Kill();
 
+    // leaves the child running past the destructor and returns its pid
+    int Detach() noexcept;
+
     TOFdStream& In();
 
     TIFdStream& Out();
@@ -2,6 +2,7 @@
 #include <algorithm>
 #include <vector>
 #include <compare>
+#include <stdexcept>
 
 
 template <typename T, typename TCmp = std::less<T>, typename TAllocator = std::allocator<T>>
@@ -0,0 +1,73 @@
+#include "buffer_list.h"
+
+TBufferList::TBufferList() noexcept
+    : Buffers{}
+    , Head{0}
+    , Bytes{0}
+{}
+
+void TBufferList::Borrow(std::span<const std::byte> data) {
+    Push(TSegment{data, nullptr});
+}
+
+void TBufferList::Borrow(std::string_view data) {
+    Borrow(std::as_bytes(std::span{data}));
+}
+
+void TBufferList::Own(std::string data) {
+    // the string lives on the heap, so its short string buffer doesn't move
+    auto owner = std::make_shared<const std::string>(std::move(data));
+    auto bytes = std::as_bytes(std::span{*owner});
+    Push(TSegment{bytes, std::move(owner)});
+}
+
+void TBufferList::Own(std::vector<std::byte> data) {
+    auto owner = std::make_shared<const std::vector<std::byte>>(std::move(data));
+    auto bytes = std::span<const std::byte>{*owner};
+    Push(TSegment{bytes, std::move(owner)});
+}
+
+void TBufferList::Share(std::shared_ptr<const void> owner, std::span<const std::byte> data) {
+    Push(TSegment{data, std::move(owner)});
+}
+
+std::span<const TBufferList::TSegment> TBufferList::Segments() const noexcept {
+    return std::span{Buffers}.subspan(Head);
+}
+
+std::size_t TBufferList::Size() const noexcept {
+    return Bytes;
+}
+
+bool TBufferList::Empty() const noexcept {
+    return Bytes == 0;
+}
+
+void TBufferList::Consume(std::size_t bytes) noexcept {
+    Bytes -= std::min(bytes, Bytes);
+    while (Head < Buffers.size()) {
+        auto& segment = Buffers[Head];
+        if (bytes < segment.Data.size()) {
+            segment.Data = segment.Data.subspan(bytes);
+            return;
+        }
+        bytes -= segment.Data.size();
+        segment = TSegment{};
+        ++Head;
+    }
+    Clear();
+}
+
+void TBufferList::Clear() noexcept {
+    Buffers.clear();
+    Head = 0;
+    Bytes = 0;
+}
+
+void TBufferList::Push(TSegment&& segment) {
+    if (segment.Data.empty()) {
+        return;
+    }
+    Bytes += segment.Data.size();
+    Buffers.push_back(std::move(segment));
+}
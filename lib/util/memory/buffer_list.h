@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Buffers to be written in order without copying them together. A buffer is
+// borrowed from the caller, owned by the list or shared with a refcounted
+// owner. Written bytes are consumed from the front
+class TBufferList {
+public:
+    struct TSegment {
+        std::span<const std::byte> Data;
+        // null for borrowed data
+        std::shared_ptr<const void> Owner;
+    };
+
+public:
+    TBufferList() noexcept;
+
+    // the data must outlive the list or its write
+    void Borrow(std::span<const std::byte> data);
+
+    void Borrow(std::string_view data);
+
+    void Own(std::string data);
+
+    void Own(std::vector<std::byte> data);
+
+    void Share(std::shared_ptr<const void> owner, std::span<const std::byte> data);
+
+    // the buffers not yet consumed
+    [[nodiscard]]
+    std::span<const TSegment> Segments() const noexcept;
+
+    // bytes not yet consumed
+    [[nodiscard]]
+    std::size_t Size() const noexcept;
+
+    [[nodiscard]]
+    bool Empty() const noexcept;
+
+    void Consume(std::size_t bytes) noexcept;
+
+    void Clear() noexcept;
+
+private:
+    void Push(TSegment&& segment);
+
+private:
+    std::vector<TSegment> Buffers;
+    std::size_t Head;
+    std::size_t Bytes;
+};
@@ -0,0 +1,68 @@
+#include "buffer_pool.h"
+
+#include <bit>
+
+namespace {
+    std::size_t ClassIndex(std::size_t size) noexcept {
+        return static_cast<std::size_t>(std::countr_zero(size) - std::countr_zero(TBufferPool::MinSize));
+    }
+}
+
+TBufferPool::TBufferPool(std::size_t retained)
+    : Retained{retained}
+    , Classes{}
+{
+}
+
+TBufferPool::~TBufferPool() {
+    for (auto&& bufferClass : Classes) {
+        for (auto buffer : bufferClass.Free) {
+            delete[] buffer;
+        }
+    }
+}
+
+std::span<std::byte> TBufferPool::Acquire(std::size_t size) {
+    size = RoundUp(size);
+    if (size > MaxSize) {
+        return {new std::byte[size], size};
+    }
+    auto& bufferClass = Classes[ClassIndex(size)];
+    {
+        std::lock_guard lock{bufferClass.Mutex};
+        if (!bufferClass.Free.empty()) {
+            auto buffer = bufferClass.Free.back();
+            bufferClass.Free.pop_back();
+            return {buffer, size};
+        }
+    }
+    return {new std::byte[size], size};
+}
+
+void TBufferPool::Release(std::span<std::byte> buffer) noexcept {
+    if (buffer.empty()) {
+        return;
+    }
+    if (buffer.size() <= MaxSize) {
+        auto& bufferClass = Classes[ClassIndex(buffer.size())];
+        std::lock_guard lock{bufferClass.Mutex};
+        if (bufferClass.Free.size() < Retained) {
+            try {
+                bufferClass.Free.push_back(buffer.data());
+                return;
+            } catch (...) {
+                // the buffer is freed instead
+            }
+        }
+    }
+    delete[] buffer.data();
+}
+
+std::size_t TBufferPool::RoundUp(std::size_t size) noexcept {
+    return size <= MinSize ? MinSize : std::bit_ceil(size);
+}
+
+TBufferPool& TBufferPool::Default() {
+    static auto pool = new TBufferPool{};
+    return *pool;
+}
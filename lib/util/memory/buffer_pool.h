@@ -0,0 +1,52 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <mutex>
+#include <span>
+#include <vector>
+
+// Free lists of buffers by power of two size classes, so buffers that are
+// needed only now and then don't have to be kept or allocated every time.
+// Sizes above the largest class are allocated and freed directly
+class TBufferPool {
+public:
+    static constexpr std::size_t MinSize = 256;
+    static constexpr std::size_t MaxSize = std::size_t{1} << 20;
+
+public:
+    // at most retained free buffers are kept in every class
+    explicit TBufferPool(std::size_t retained = 1024);
+
+    TBufferPool(const TBufferPool&) = delete;
+    TBufferPool& operator=(const TBufferPool&) = delete;
+
+    ~TBufferPool();
+
+    // the buffer is at least size bytes, its size is the class size
+    [[nodiscard]]
+    std::span<std::byte> Acquire(std::size_t size);
+
+    // takes a buffer returned by Acquire
+    void Release(std::span<std::byte> buffer) noexcept;
+
+    [[nodiscard]]
+    static std::size_t RoundUp(std::size_t size) noexcept;
+
+    // the pool shared by the fd streams, it's never destroyed so buffers can
+    // be released by objects destroyed at exit
+    [[nodiscard]]
+    static TBufferPool& Default();
+
+private:
+    struct TClass {
+        std::mutex Mutex;
+        std::vector<std::byte*> Free;
+    };
+
+    static constexpr std::size_t ClassCount = 13;
+
+private:
+    std::size_t Retained;
+    std::array<TClass, ClassCount> Classes;
+};
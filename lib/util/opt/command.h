@@ -3,6 +3,7 @@
 #include <util/opt/opt.h>
 
 #include <variant>
+#include <optional>
 #include <unordered_map>
 #include <vector>
 
@@ -1,5 +1,7 @@
 #include "json_io.h"
 
+#include <limits>
+
 #include <util/string/utils.h>
 
 #include <util/exception/exception.h>
@@ -0,0 +1,87 @@
+#include <posix/net/client.h>
+#include <posix/net/restart.h>
+#include <posix/net/server.h>
+
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <thread>
+
+#include <sys/wait.h>
+
+namespace {
+    constexpr int Connections = 64;
+
+    // serves the inherited listeners with more reactors than there are of them
+    int RunRestarted() {
+        auto inherited = NRestart::InheritSockets();
+        if (inherited.Listeners.size() != 2) {
+            return 2;
+        }
+        TStopToken token;
+        auto replier = [&token](TConnectedSocket& socket) {
+            std::string line;
+            if (!std::getline(socket, line)) {
+                return socket.WouldBlock();
+            }
+            if (line == "quit") {
+                token.Stop();
+            }
+            socket << "restarted " << line << std::endl;
+            return true;
+        };
+        TServerConfig config;
+        config.Reactors = 8;
+        TServer server{replier, std::move(inherited.Listeners), config};
+        server(token);
+        return 0;
+    }
+
+    bool Ask(int port, const std::string& request, const std::string& expected) {
+        auto socket = NInternal::ConnectIP("127.0.0.1", port);
+        socket << request << std::endl;
+        std::string line;
+        return std::getline(socket, line) && line == expected;
+    }
+}
+
+int main(int argc, char**) {
+    if (argc > 1) {
+        return RunRestarted();
+    }
+
+    auto replier = [](TConnectedSocket& socket) {
+        std::string line;
+        if (!std::getline(socket, line)) {
+            return socket.WouldBlock();
+        }
+        socket << "old " << line << std::endl;
+        return true;
+    };
+    TServerConfig config;
+    config.Reactors = 2;
+    config.ReusePort = true;
+    TServer server{replier, 0, 16, config};
+    auto port = NInternal::GetPort(server.GetSocket());
+
+    TStopToken token;
+    std::thread serving{[&] { server(token); }};
+    auto pid = NRestart::Start("/proc/self/exe", {"restarted"}, server.GetListeners());
+    std::this_thread::sleep_for(std::chrono::milliseconds{200});
+    token.Stop();
+    serving.join();
+
+    int served = 0;
+    for (int i = 0; i < Connections; ++i) {
+        served += Ask(port, "ping", "restarted ping");
+    }
+    Ask(port, "quit", "restarted quit");
+
+    int status = 0;
+    waitpid(pid, std::addressof(status), 0);
+    if (served != Connections || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        std::cerr << served << " of " << Connections << " served, restarted server status " << status << std::endl;
+        return 1;
+    }
+    return 0;
+}
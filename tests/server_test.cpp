@@ -0,0 +1,54 @@
+#include <posix/net/client.h>
+#include <posix/net/server.h>
+
+#include <util/memory/buffer_list.h>
+
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <thread>
+
+namespace {
+    // far more than a socket buffer holds, so the reactor's write blocks
+    constexpr std::size_t ResponseSize = std::size_t{16} << 20;
+}
+
+// A reactor replier writes a buffer list bigger than the socket buffer to a
+// client that reads slowly, all of it has to arrive
+int main() {
+    TStopToken token;
+    auto replier = [](TConnectedSocket& socket) {
+        std::string line;
+        if (!std::getline(socket, line)) {
+            return socket.WouldBlock();
+        }
+        TBufferList buffers;
+        buffers.Own(std::string(ResponseSize / 2, 'a'));
+        buffers.Own(std::string(ResponseSize / 2, 'b'));
+        buffers.Borrow(std::string_view{"\n"});
+        socket.WriteBuffers(buffers);
+        return socket.good() && buffers.Empty();
+    };
+    TServerConfig config;
+    config.Reactors = 1;
+    TServer server{replier, 0, 16, config};
+    auto port = NInternal::GetPort(server.GetSocket());
+    std::thread serving{[&] { server(token); }};
+
+    auto socket = NInternal::ConnectIP("127.0.0.1", port);
+    socket << "get" << std::endl;
+    std::this_thread::sleep_for(std::chrono::milliseconds{100});
+    std::string response;
+    std::getline(socket, response);
+    token.Stop();
+    serving.join();
+
+    auto half = response.size() / 2;
+    if (response.size() != ResponseSize || response.find_first_not_of('a') != half
+        || response.find_first_not_of('b', half) != std::string::npos)
+    {
+        std::cerr << "got " << response.size() << " of " << ResponseSize << " bytes" << std::endl;
+        return 1;
+    }
+    return 0;
+}